@@ -0,0 +1,137 @@
+#include "daycache.h"
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+static const quint32 CacheMagic = 0x4b444e43;   // "KDNC"
+
+// Bump whenever DayContent, the markdown parser or TagIndex::extract()
+// changes meaning; older cache files are then ignored and rebuilt.
+// 2: lone stars next to a bold pair stay literal text
+static const quint32 CacheVersion = 2;
+
+DayCache::DayCache(const QString &cachePath)
+    : path(cachePath)
+    , modified(false)
+{
+}
+
+bool DayCache::load()
+{
+    entries.clear();
+    modified = false;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != CacheMagic || version != CacheVersion)
+        return false;
+
+    QHash<QByteArray, QByteArray> loaded;
+    in >> loaded;
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    entries = loaded;
+    return true;
+}
+
+bool DayCache::save()
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << CacheMagic << CacheVersion << entries;
+    if (out.status() != QDataStream::Ok || !file.commit())
+        return false;
+
+    modified = false;
+    return true;
+}
+
+bool DayCache::lookup(const QByteArray &hash, DayContent &content) const
+{
+    auto it = entries.constFind(hash);
+    return it != entries.cend() && deserialize(it.value(), content);
+}
+
+void DayCache::insert(const QByteArray &hash, const QByteArray &data)
+{
+    entries.insert(hash, data);
+    modified = true;
+}
+
+void DayCache::retainOnly(const QSet<QByteArray> &hashes)
+{
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (hashes.contains(it.key())) {
+            ++it;
+        } else {
+            it = entries.erase(it);
+            modified = true;
+        }
+    }
+}
+
+QByteArray DayCache::serialize(const DayContent &content)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+
+    out << quint32(content.blocks.size());
+    for (const DayContent::Block &block : content.blocks) {
+        out << block.text << quint32(block.runs.size());
+        for (const DayContent::Run &run : block.runs)
+            out << qint32(run.length) << run.format;
+        out << block.tags;
+    }
+    return data;
+}
+
+bool DayCache::deserialize(const QByteArray &data, DayContent &content)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 blockCount = 0;
+    in >> blockCount;
+    DayContent result;
+    for (quint32 i = 0; i < blockCount && in.status() == QDataStream::Ok; ++i) {
+        DayContent::Block block;
+        quint32 runCount = 0;
+        in >> block.text >> runCount;
+
+        // Runs must exactly cover the text, or the entry is not trusted
+        qint64 covered = 0;
+        for (quint32 j = 0; j < runCount && in.status() == QDataStream::Ok; ++j) {
+            qint32 length = 0;
+            DayContent::Run run;
+            in >> length >> run.format;
+            if (length <= 0)
+                return false;
+            run.length = length;
+            covered += length;
+            block.runs.append(run);
+        }
+        if (covered != block.text.size())
+            return false;
+
+        in >> block.tags;
+        result.blocks.append(block);
+    }
+    if (in.status() != QDataStream::Ok || !in.atEnd())
+        return false;
+
+    content = result;
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include "daycontent.h"
+
+// Parsed DayContent of every day, keyed by the hash of its markdown and
+// stored in a versioned binary file next to the diary. A day whose
+// markdown is unchanged is rebuilt from here without being parsed.
+class DayCache
+{
+public:
+    explicit DayCache(const QString &path);
+
+    bool load();
+    bool save();
+    bool isModified() const { return modified; }
+
+    // Safe to call from several threads at once, as long as nothing inserts
+    bool lookup(const QByteArray &hash, DayContent &content) const;
+    void insert(const QByteArray &hash, const QByteArray &data);
+    void retainOnly(const QSet<QByteArray> &hashes);
+
+    static QByteArray serialize(const DayContent &content);
+    static bool deserialize(const QByteArray &data, DayContent &content);
+
+private:
+    QString path;
+    QHash<QByteArray, QByteArray> entries;
+    bool modified;
+};
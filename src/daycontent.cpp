@@ -0,0 +1,432 @@
+#include "daycontent.h"
+#include "tagindex.h"
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextCharFormat>
+#include <QTextBlockFormat>
+#include <utility>
+
+static void appendText(DayContent::Block &block, QStringView text, quint8 format)
+{
+    if (text.isEmpty())
+        return;
+    block.text += text;
+    if (!block.runs.isEmpty() && block.runs.last().format == format) {
+        block.runs.last().length += text.size();
+    } else {
+        DayContent::Run run;
+        run.length = text.size();
+        run.format = format;
+        block.runs.append(run);
+    }
+}
+
+// Pairs up single-character markers the way the non-greedy \*(.+?)\* and
+// _(.+?)_ patterns did: an opening marker closes at the next free marker
+// with at least one character between them.
+static void pairMarkers(QStringView para, QChar marker, QList<quint8> &toggles, quint8 format)
+{
+    QList<int> free;
+    for (int i = 0; i < para.size(); ++i) {
+        if (para[i] == marker && toggles.at(i) == DayContent::Plain)
+            free.append(i);
+    }
+    int k = 0;
+    while (k < free.size()) {
+        int m = k + 1;
+        while (m < free.size() && free.at(m) < free.at(k) + 2)
+            ++m;
+        if (m == free.size()) {
+            ++k;
+            continue;
+        }
+        toggles[free.at(k)] = format;
+        toggles[free.at(m)] = format;
+        k = m + 1;
+    }
+}
+
+// Resolves markers in the order the original patterns were applied:
+// **bold** pairs first, then *italic* and _underline_ among what is left,
+// so a lone star next to a bold pair stays literal text.
+static DayContent::Block parseParagraph(QStringView para)
+{
+    const int n = para.size();
+    QList<quint8> toggles(n, DayContent::Plain);    // Format a marker character toggles
+
+    int i = para.indexOf(u"**");
+    while (i >= 0) {
+        const int close = para.indexOf(u"**", i + 3);
+        if (close < 0)
+            break;
+        toggles[i] = toggles[i + 1] = DayContent::Bold;
+        toggles[close] = toggles[close + 1] = DayContent::Bold;
+        i = para.indexOf(u"**", close + 2);
+    }
+    pairMarkers(para, QLatin1Char('*'), toggles, DayContent::Italic);
+    pairMarkers(para, QLatin1Char('_'), toggles, DayContent::Underline);
+
+    DayContent::Block block;
+    quint8 format = DayContent::Plain;
+    int textStart = 0;
+    i = 0;
+    while (i < n) {
+        const quint8 toggle = toggles.at(i);
+        if (toggle == DayContent::Plain) {
+            ++i;
+            continue;
+        }
+        appendText(block, para.mid(textStart, i - textStart), format);
+        format ^= toggle;
+        i += toggle == DayContent::Bold ? 2 : 1;
+        textStart = i;
+    }
+    appendText(block, para.mid(textStart), format);
+    return block;
+}
+
+DayContent DayContent::fromMarkdown(const QString &markdown)
+{
+    DayContent content;
+
+    // Paragraphs are separated by blank lines; single newlines inside a
+    // paragraph are folded into spaces
+    QString paragraph;
+    auto flush = [&]() {
+        const QString para = paragraph.trimmed();
+        if (!para.isEmpty()) {
+            Block block = parseParagraph(para);
+            block.tags = TagIndex::extract(block.text);
+            content.blocks.append(block);
+        }
+        paragraph.clear();
+    };
+
+    const QStringView text(markdown);
+    int lineStart = 0;
+    while (lineStart <= text.size()) {
+        int lineEnd = text.indexOf(QLatin1Char('\n'), lineStart);
+        if (lineEnd < 0)
+            lineEnd = text.size();
+        const QStringView line = text.mid(lineStart, lineEnd - lineStart);
+
+        if (line.trimmed().isEmpty()) {
+            flush();
+        } else {
+            if (!paragraph.isEmpty())
+                paragraph += QLatin1Char(' ');
+            paragraph += line;
+        }
+        lineStart = lineEnd + 1;
+    }
+    flush();
+
+    return content;
+}
+
+DayContent DayContent::fromPlainText(QStringView text)
+{
+    DayContent content;
+    int lineStart = 0;
+    while (lineStart <= text.size()) {
+        int lineEnd = text.indexOf(QLatin1Char('\n'), lineStart);
+        if (lineEnd < 0)
+            lineEnd = text.size();
+        QStringView line = text.mid(lineStart, lineEnd - lineStart);
+        if (line.endsWith(QLatin1Char('\r')))
+            line.chop(1);
+
+        Block block;
+        appendText(block, line, Plain);
+        content.blocks.append(block);
+        lineStart = lineEnd + 1;
+    }
+    return content;
+}
+
+static bool isBlockTag(QStringView name)
+{
+    static const char *const tags[] = {
+        "p", "div", "br", "li", "tr", "h1", "h2", "h3", "h4", "h5", "h6",
+        "blockquote", "pre", "ul", "ol", "table", "hr", "dt", "dd",
+    };
+    for (const char *tag : tags) {
+        if (name.compare(QLatin1String(tag), Qt::CaseInsensitive) == 0)
+            return true;
+    }
+    return false;
+}
+
+static bool isSkippedTag(QStringView name)
+{
+    return name.compare(QLatin1String("script"), Qt::CaseInsensitive) == 0
+        || name.compare(QLatin1String("style"), Qt::CaseInsensitive) == 0
+        || name.compare(QLatin1String("head"), Qt::CaseInsensitive) == 0
+        || name.compare(QLatin1String("title"), Qt::CaseInsensitive) == 0;
+}
+
+static quint8 tagFormat(QStringView name)
+{
+    if (name.compare(QLatin1String("b"), Qt::CaseInsensitive) == 0
+        || name.compare(QLatin1String("strong"), Qt::CaseInsensitive) == 0)
+        return DayContent::Bold;
+    if (name.compare(QLatin1String("i"), Qt::CaseInsensitive) == 0
+        || name.compare(QLatin1String("em"), Qt::CaseInsensitive) == 0)
+        return DayContent::Italic;
+    if (name.compare(QLatin1String("u"), Qt::CaseInsensitive) == 0
+        || name.compare(QLatin1String("ins"), Qt::CaseInsensitive) == 0)
+        return DayContent::Underline;
+    return DayContent::Plain;
+}
+
+// Formats set through inline styles, as produced by Qt's own rich text export
+static quint8 styleFormat(QStringView tag)
+{
+    int styleStart = tag.indexOf(QLatin1String("style="), 0, Qt::CaseInsensitive);
+    if (styleStart < 0)
+        return DayContent::Plain;
+    const QString style = tag.mid(styleStart).toString().toLower().remove(QLatin1Char(' '));
+
+    quint8 format = DayContent::Plain;
+    if (style.contains(QLatin1String("font-weight:bold")) || style.contains(QLatin1String("font-weight:6"))
+        || style.contains(QLatin1String("font-weight:7")) || style.contains(QLatin1String("font-weight:8"))
+        || style.contains(QLatin1String("font-weight:9")))
+        format |= DayContent::Bold;
+    if (style.contains(QLatin1String("font-style:italic")))
+        format |= DayContent::Italic;
+    if (style.contains(QLatin1String("text-decoration:underline")))
+        format |= DayContent::Underline;
+    return format;
+}
+
+// Elements whose text keeps its line breaks and spacing
+static bool isPreformatted(QStringView name, QStringView tag)
+{
+    if (name.compare(QLatin1String("pre"), Qt::CaseInsensitive) == 0)
+        return true;
+    int styleStart = tag.indexOf(QLatin1String("style="), 0, Qt::CaseInsensitive);
+    if (styleStart < 0)
+        return false;
+    const QString style = tag.mid(styleStart).toString().toLower().remove(QLatin1Char(' '));
+    return style.contains(QLatin1String("white-space:pre"));
+}
+
+static QString decodeEntity(QStringView entity)
+{
+    if (entity.startsWith(QLatin1Char('#'))) {
+        bool ok = false;
+        uint code = entity.startsWith(QLatin1String("#x"), Qt::CaseInsensitive)
+            ? entity.mid(2).toUInt(&ok, 16)
+            : entity.mid(1).toUInt(&ok, 10);
+        if (!ok || code == 0 || code > 0x10FFFF || QChar::isSurrogate(code))
+            return QString(QChar::ReplacementCharacter);
+        // Characters outside the BMP, such as emoji, become a surrogate pair
+        const char32_t ucs4 = code;
+        return QString::fromUcs4(&ucs4, 1);
+    }
+    if (entity == QLatin1String("amp"))
+        return QStringLiteral("&");
+    if (entity == QLatin1String("lt"))
+        return QStringLiteral("<");
+    if (entity == QLatin1String("gt"))
+        return QStringLiteral(">");
+    if (entity == QLatin1String("quot"))
+        return QStringLiteral("\"");
+    if (entity == QLatin1String("apos"))
+        return QStringLiteral("'");
+    if (entity == QLatin1String("nbsp"))
+        return QStringLiteral(" ");
+    return QString();
+}
+
+DayContent DayContent::fromHtml(QStringView html)
+{
+    // Single streaming pass: tags adjust the current format, block-level
+    // tags end the current paragraph and everything else is dropped
+    DayContent content;
+    Block block;
+    int formatDepth[3] = {0, 0, 0};     // Nesting of b/i/u style tags
+    QList<quint8> spanFormats;          // Formats pushed by styled spans
+    QStringList preElements;            // Open elements that preserve whitespace
+    int skipDepth = 0;
+    bool pendingSpace = false;
+    quint8 pendingSpaceFormat = Plain;
+
+    auto currentFormat = [&]() {
+        quint8 format = Plain;
+        if (formatDepth[0] > 0)
+            format |= Bold;
+        if (formatDepth[1] > 0)
+            format |= Italic;
+        if (formatDepth[2] > 0)
+            format |= Underline;
+        for (quint8 spanFormat : std::as_const(spanFormats))
+            format |= spanFormat;
+        return format;
+    };
+    auto endBlock = [&](bool keepEmpty = false) {
+        if (keepEmpty || !block.text.isEmpty())
+            content.blocks.append(block);
+        block = Block();
+        pendingSpace = false;
+    };
+    auto appendChar = [&](QChar c) {
+        if (skipDepth > 0)
+            return;
+        if (!preElements.isEmpty()) {
+            // Preformatted lines stay separate blocks, blank ones included
+            if (c == QLatin1Char('\n')) {
+                endBlock(true);
+                return;
+            }
+            if (c == QLatin1Char('\r'))
+                return;
+        } else if (c.isSpace()) {
+            // Runs of whitespace collapse to one space, formatted as where the run began
+            if (!pendingSpace && !block.text.isEmpty()) {
+                pendingSpace = true;
+                pendingSpaceFormat = currentFormat();
+            }
+            return;
+        }
+        if (pendingSpace) {
+            appendText(block, u" ", pendingSpaceFormat);
+            pendingSpace = false;
+        }
+        appendText(block, QStringView(&c, 1), currentFormat());
+    };
+
+    const int n = html.size();
+    int i = 0;
+    while (i < n) {
+        const QChar c = html[i];
+
+        if (c == QLatin1Char('<')) {
+            if (html.mid(i, 4) == QLatin1String("<!--")) {
+                int end = html.indexOf(QLatin1String("-->"), i + 4);
+                i = end < 0 ? n : end + 3;
+                continue;
+            }
+            int end = html.indexOf(QLatin1Char('>'), i + 1);
+            if (end < 0)
+                break;
+            const QStringView tag = html.mid(i + 1, end - i - 1);
+            i = end + 1;
+
+            const bool closing = tag.startsWith(QLatin1Char('/'));
+            const bool selfClosing = tag.endsWith(QLatin1Char('/'));
+            int nameStart = closing ? 1 : 0;
+            int nameEnd = nameStart;
+            while (nameEnd < tag.size() && tag[nameEnd].isLetterOrNumber())
+                ++nameEnd;
+            const QStringView name = tag.mid(nameStart, nameEnd - nameStart);
+
+            // Nested elements of the same name are tracked too, so the
+            // matching close tag is the one that ends preformatting
+            bool openedPre = false;
+            if (closing) {
+                if (!preElements.isEmpty() && name.compare(preElements.last(), Qt::CaseInsensitive) == 0)
+                    preElements.removeLast();
+            } else if (!selfClosing
+                       && (isPreformatted(name, tag)
+                           || (!preElements.isEmpty() && name.compare(preElements.last(), Qt::CaseInsensitive) == 0))) {
+                openedPre = preElements.isEmpty();
+                preElements.append(name.toString());
+            }
+
+            if (isSkippedTag(name)) {
+                if (closing)
+                    skipDepth = qMax(0, skipDepth - 1);
+                else if (!selfClosing)
+                    ++skipDepth;
+            } else if (isBlockTag(name)) {
+                endBlock();
+            } else if (quint8 format = tagFormat(name)) {
+                int &depth = formatDepth[format == Bold ? 0 : format == Italic ? 1 : 2];
+                depth = closing ? qMax(0, depth - 1) : depth + 1;
+            } else if (name.compare(QLatin1String("span"), Qt::CaseInsensitive) == 0) {
+                if (closing) {
+                    if (!spanFormats.isEmpty())
+                        spanFormats.removeLast();
+                } else if (!selfClosing) {
+                    spanFormats.append(styleFormat(tag));
+                }
+            }
+
+            // As in HTML, a line break right after the opening tag is not content
+            if (openedPre && i < n && html[i] == QLatin1Char('\n'))
+                ++i;
+            continue;
+        }
+
+        if (c == QLatin1Char('&')) {
+            int end = html.indexOf(QLatin1Char(';'), i + 1);
+            if (end > 0 && end - i <= 10) {
+                const QString decoded = decodeEntity(html.mid(i + 1, end - i - 1));
+                if (!decoded.isEmpty()) {
+                    for (QChar decodedChar : decoded)
+                        appendChar(decodedChar);
+                    i = end + 1;
+                    continue;
+                }
+            }
+        }
+
+        appendChar(c);
+        ++i;
+    }
+    endBlock();
+
+    return content;
+}
+
+static QTextCharFormat charFormatFor(quint8 format)
+{
+    QTextCharFormat charFormat;
+    if (format & DayContent::Bold)
+        charFormat.setFontWeight(QFont::Bold);
+    if (format & DayContent::Italic)
+        charFormat.setFontItalic(true);
+    if (format & DayContent::Underline)
+        charFormat.setFontUnderline(true);
+    return charFormat;
+}
+
+void DayContent::insertBlock(QTextCursor &cursor, const Block &block, int from, int length)
+{
+    const int end = length < 0 ? block.text.size() : qMin(block.text.size(), from + length);
+    int position = 0;
+    for (const Run &run : block.runs) {
+        const int start = qMax(position, from);
+        const int stop = qMin(position + run.length, end);
+        if (start < stop)
+            cursor.insertText(block.text.mid(start, stop - start), charFormatFor(run.format));
+        position += run.length;
+        if (position >= end)
+            break;
+    }
+}
+
+void DayContent::applyTo(QTextDocument *document) const
+{
+    // Loading is not an undoable edit
+    document->setUndoRedoEnabled(false);
+    document->clear();
+
+    QTextBlockFormat blockFormat;
+    blockFormat.setTopMargin(1);
+    blockFormat.setBottomMargin(1);
+
+    QTextCursor cursor(document);
+    cursor.beginEditBlock();
+    for (int i = 0; i < blocks.size(); ++i) {
+        if (i == 0)
+            cursor.setBlockFormat(blockFormat);
+        else
+            cursor.insertBlock(blockFormat, QTextCharFormat());
+        insertBlock(cursor, blocks.at(i));
+    }
+    cursor.endEditBlock();
+
+    document->setUndoRedoEnabled(true);
+}
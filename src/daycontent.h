@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+class QTextCursor;
+class QTextDocument;
+
+// A day's text reduced to paragraphs and bold/italic/underline runs.
+// Building one touches no GUI objects, so days can be converted on
+// worker threads and only applied to their documents on the GUI thread.
+struct DayContent
+{
+    enum Format : quint8 {
+        Plain = 0,
+        Bold = 1,
+        Italic = 2,
+        Underline = 4
+    };
+
+    struct Run
+    {
+        int length = 0;
+        quint8 format = Plain;
+    };
+
+    struct Block
+    {
+        QString text;
+        QList<Run> runs;    // Consecutive runs covering all of text
+        QStringList tags;   // #tags and @mentions found in text
+    };
+
+    QList<Block> blocks;
+
+    static DayContent fromMarkdown(const QString &markdown);
+    static DayContent fromPlainText(QStringView text);
+    static DayContent fromHtml(QStringView html);
+    void applyTo(QTextDocument *document) const;
+    static void insertBlock(QTextCursor &cursor, const Block &block, int from = 0, int length = -1);
+};
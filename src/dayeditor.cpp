@@ -1,12 +1,62 @@
 #include "dayeditor.h"
 #include <QKeyEvent>
 #include <QTextBlock>
-#include <QRegularExpression>
+#include <QTextLayout>
 #include <QApplication>
+#include <QMimeData>
+#include <QTimer>
+#include <utility>
+
+// Characters inserted per event loop iteration when pasting large content
+static const int PasteChunkSize = 32 * 1024;
+
+// Beyond this size a day is never measured; it is shown collapsed
+static const int GiantDayCharacters = 50 * 1000;
+
+struct TagTally
+{
+    TagCounts counts;
+    quint64 revision = 0;
+};
+
+// Tags of one block. Blocks own their user data, so when Qt deletes a
+// block (or its data is replaced) the day's tally is corrected right here.
+class TagBlockData : public QTextBlockUserData
+{
+public:
+    TagBlockData(const QStringList &blockTags, const QSharedPointer<TagTally> &dayTally)
+        : tags(blockTags)
+        , tally(dayTally)
+    {
+        for (const QString &tag : tags)
+            ++tally->counts[tag];
+        ++tally->revision;
+    }
+
+    ~TagBlockData() override
+    {
+        for (const QString &tag : std::as_const(tags)) {
+            auto it = tally->counts.find(tag);
+            if (it != tally->counts.end() && --it.value() <= 0)
+                tally->counts.erase(it);
+        }
+        ++tally->revision;
+    }
+
+    const QStringList tags;
+    const QSharedPointer<TagTally> tally;
+};
 
 DayEditor::DayEditor(const QDate &date, QWidget *parent)
     : KTextEdit(parent)
     , m_date(date)
+    , m_row(-1)
+    , m_pasteBlock(0)
+    , m_pasteOffset(0)
+    , m_collapsedHeight(600)
+    , m_tags(new TagTally)
+    , m_tagRevision(0)
+    , m_loadingContent(false)
 {
     setAcceptRichText(true);
     setFrameStyle(QFrame::StyledPanel | QFrame::Sunken);
@@ -20,33 +70,75 @@ DayEditor::DayEditor(const QDate &date, QWidget *parent)
     setPalette(p);
     
     connect(document(), &QTextDocument::contentsChanged, this, &DayEditor::updateGeometry);
+    connect(document(), &QTextDocument::contentsChange, this, &DayEditor::onContentsChange);
 }
 
 void DayEditor::setContent(const QString &content)
 {
-    // Convert markdown formatting to rich text
-    QString html = QStringLiteral("<!DOCTYPE HTML><html><body>");
-    
-    // Split content into paragraphs on double newlines
-    QStringList paragraphs = content.split(QRegularExpression(QStringLiteral("\n\\s*\n")));
-    for (int i = 0; i < paragraphs.size(); ++i) {
-        QString para = paragraphs[i].trimmed();
-        if (!para.isEmpty()) {
-            // Apply formatting
-            para.replace(QRegularExpression(QStringLiteral("\\*\\*(.+?)\\*\\*")), 
-                        QStringLiteral("<b>\\1</b>"));
-            para.replace(QRegularExpression(QStringLiteral("\\*(.+?)\\*")), 
-                        QStringLiteral("<i>\\1</i>"));
-            para.replace(QRegularExpression(QStringLiteral("_(.+?)_")), 
-                        QStringLiteral("<u>\\1</u>"));
-            html += QStringLiteral("<p style=\"margin: 1px 0;\">") + para + QStringLiteral("</p>");
-        }
-    }
+    setDayContent(DayContent::fromMarkdown(content));
+}
+
+void DayEditor::setDayContent(const DayContent &content)
+{
+    // Replacing the document abandons any paste still in progress
+    m_pendingPaste = DayContent();
+    m_pasteBlock = 0;
+    m_pasteOffset = 0;
+    m_loadingContent = true;
+    content.applyTo(document());
+    m_loadingContent = false;
     
-    html += QStringLiteral("</body></html>");
+    // Tags were extracted while parsing; attach them instead of rescanning
+    QTextBlock block = document()->firstBlock();
+    for (const DayContent::Block &parsed : content.blocks) {
+        if (!block.isValid())
+            break;
+        setBlockTags(block, parsed.tags);
+        block = block.next();
+    }
     
-    setHtml(html);
     document()->setModified(false);
+    emitTagsIfChanged();
+}
+
+TagCounts DayEditor::tags() const
+{
+    return m_tags->counts;
+}
+
+void DayEditor::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+    if (m_loadingContent)
+        return;
+    
+    // Rescan only the blocks the edit touched; removed blocks already
+    // took their tags with them
+    QTextBlock block = document()->findBlock(position);
+    const QTextBlock last = document()->findBlock(position + charsAdded);
+    while (block.isValid()) {
+        setBlockTags(block, TagIndex::extract(block.text()));
+        if (block == last)
+            break;
+        block = block.next();
+    }
+    emitTagsIfChanged();
+}
+
+void DayEditor::setBlockTags(QTextBlock block, const QStringList &tags)
+{
+    const TagBlockData *data = static_cast<TagBlockData*>(block.userData());
+    if (data ? data->tags == tags : tags.isEmpty())
+        return;
+    block.setUserData(tags.isEmpty() ? nullptr : new TagBlockData(tags, m_tags));
+}
+
+void DayEditor::emitTagsIfChanged()
+{
+    if (m_tags->revision == m_tagRevision)
+        return;
+    m_tagRevision = m_tags->revision;
+    Q_EMIT tagsChanged();
 }
 
 QString DayEditor::content() const
@@ -120,8 +212,35 @@ QString DayEditor::content() const
     return markdown;
 }
 
+QJsonObject DayEditor::stats() const
+{
+    const QTextDocument *doc = document();
+    int fragments = 0;
+    int layoutLines = 0;
+    for (QTextBlock block = doc->firstBlock(); block.isValid(); block = block.next()) {
+        for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it)
+            ++fragments;
+        // Lines only exist for blocks the layout has processed and cached
+        if (const QTextLayout *blockLayout = block.layout())
+            layoutLines += blockLayout->lineCount();
+    }
+
+    QJsonObject result;
+    result[QStringLiteral("date")] = m_date.toString(Qt::ISODate);
+    result[QStringLiteral("characters")] = doc->characterCount();
+    result[QStringLiteral("blocks")] = doc->blockCount();
+    result[QStringLiteral("fragments")] = fragments;
+    result[QStringLiteral("undoSteps")] = doc->availableUndoSteps() + doc->availableRedoSteps();
+    result[QStringLiteral("layoutLines")] = layoutLines;
+    result[QStringLiteral("widgets")] = 1 + int(findChildren<QWidget*>().size());
+    return result;
+}
+
 void DayEditor::keyPressEvent(QKeyEvent *event)
 {
+    // The user's next edit or undo must not land inside the paste's undo step
+    finishPendingPaste();
+    
     if (event->key() == Qt::Key_Return && checkListContext()) {
         handleListContinuation();
         return;
@@ -153,6 +272,13 @@ void DayEditor::keyPressEvent(QKeyEvent *event)
     KTextEdit::keyPressEvent(event);
 }
 
+void DayEditor::contextMenuEvent(QContextMenuEvent *event)
+{
+    // The menu offers undo and editing actions, so settle any paste first
+    finishPendingPaste();
+    KTextEdit::contextMenuEvent(event);
+}
+
 void DayEditor::focusOutEvent(QFocusEvent *event)
 {
     // Only handle focus out if it's going outside our window
@@ -162,19 +288,116 @@ void DayEditor::focusOutEvent(QFocusEvent *event)
     KTextEdit::focusOutEvent(event);
 }
 
+void DayEditor::insertFromMimeData(const QMimeData *source)
+{
+    // Reduce the clipboard to what content() can represent before it
+    // ever reaches the document
+    DayContent pasted;
+    if (source->hasHtml()) {
+        pasted = DayContent::fromHtml(source->html());
+    } else if (source->hasText()) {
+        pasted = DayContent::fromPlainText(source->text());
+    } else {
+        return;
+    }
+    if (pasted.blocks.isEmpty())
+        return;
+    
+    finishPendingPaste();
+    
+    m_pendingPaste = pasted;
+    m_pasteBlock = 0;
+    m_pasteOffset = 0;
+    m_pasteCursor = textCursor();
+    pasteNextChunk();
+    setTextCursor(m_pasteCursor);
+}
+
+void DayEditor::pasteNextChunk()
+{
+    const int blockCount = m_pendingPaste.blocks.size();
+    if (m_pasteBlock >= blockCount)
+        return;
+    
+    // Later chunks join the first edit block so the paste undoes as one step
+    if (m_pasteBlock == 0 && m_pasteOffset == 0) {
+        m_pasteCursor.beginEditBlock();
+        m_pasteCursor.removeSelectedText();
+    } else {
+        m_pasteCursor.joinPreviousEditBlock();
+    }
+    // Blocks longer than a chunk, such as a log pasted as one line, are
+    // split by character count and continue in the next chunk
+    int inserted = 0;
+    while (m_pasteBlock < blockCount && inserted < PasteChunkSize) {
+        const DayContent::Block &block = m_pendingPaste.blocks.at(m_pasteBlock);
+        if (m_pasteBlock > 0 && m_pasteOffset == 0)
+            m_pasteCursor.insertBlock();
+        int length = qMin(int(block.text.size()) - m_pasteOffset, PasteChunkSize - inserted);
+        if (length > 1 && block.text.at(m_pasteOffset + length - 1).isHighSurrogate())
+            --length;
+        DayContent::insertBlock(m_pasteCursor, block, m_pasteOffset, length);
+        inserted += length + 1;
+        m_pasteOffset += length;
+        if (m_pasteOffset >= block.text.size()) {
+            ++m_pasteBlock;
+            m_pasteOffset = 0;
+        }
+    }
+    m_pasteCursor.endEditBlock();
+    
+    if (m_pasteBlock < blockCount) {
+        // Let the event loop breathe before inserting the next chunk
+        QTimer::singleShot(0, this, &DayEditor::pasteNextChunk);
+    } else {
+        m_pendingPaste = DayContent();
+        m_pasteBlock = 0;
+        m_pasteOffset = 0;
+    }
+}
+
+void DayEditor::finishPendingPaste()
+{
+    while (m_pasteBlock < m_pendingPaste.blocks.size())
+        pasteNextChunk();
+}
+
 void DayEditor::resizeEvent(QResizeEvent *event)
 {
     KTextEdit::resizeEvent(event);
     updateGeometry();
 }
 
+void DayEditor::setCollapsedHeight(int height)
+{
+    height = qMax(100, height);
+    if (height == m_collapsedHeight)
+        return;
+    m_collapsedHeight = height;
+    
+    // Only collapsed days depend on it; re-measuring the rest would lay out
+    // every day again on each resize of the view
+    if (document()->characterCount() > GiantDayCharacters)
+        updateGeometry();
+}
+
 void DayEditor::updateGeometry()
 {
-    // Calculate required height based on content
-    int docHeight = document()->size().height();
-    int newHeight = qMax(100, docHeight + 20); // Minimum 100px, plus padding
+    int newHeight;
+    if (document()->characterCount() > GiantDayCharacters) {
+        // Measuring would force a full layout of the whole day; a collapsed
+        // editor scrolls internally and only lays out what it shows
+        newHeight = m_collapsedHeight;
+    } else {
+        // Calculate required height based on content
+        int docHeight = document()->size().height();
+        newHeight = qMax(100, docHeight + 20); // Minimum 100px, plus padding
+    }
+    if (newHeight == minimumHeight() && newHeight == maximumHeight())
+        return;
     setMinimumHeight(newHeight);
     setMaximumHeight(newHeight);
+    Q_EMIT heightChanged(newHeight);
 }
 
 bool DayEditor::checkListContext()
@@ -202,6 +425,7 @@ void DayEditor::handleListContinuation()
 }
 void DayEditor::toggleBold()
 {
+    finishPendingPaste();
     QTextCursor cursor = textCursor();
     QTextCharFormat format = cursor.charFormat();
     bool wasBold = (format.fontWeight() == QFont::Bold);
@@ -215,6 +439,7 @@ void DayEditor::toggleBold()
 
 void DayEditor::toggleItalic()
 {
+    finishPendingPaste();
     QTextCursor cursor = textCursor();
     QTextCharFormat format = cursor.charFormat();
     format.setFontItalic(!format.fontItalic());
@@ -226,6 +451,7 @@ void DayEditor::toggleItalic()
 
 void DayEditor::toggleUnderline()
 {
+    finishPendingPaste();
     QTextCursor cursor = textCursor();
     QTextCharFormat format = cursor.charFormat();
     format.setFontUnderline(!format.fontUnderline());
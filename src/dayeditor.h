@@ -2,6 +2,12 @@
 
 #include <KTextEdit>
 #include <QDate>
+#include <QJsonObject>
+#include <QSharedPointer>
+#include "daycontent.h"
+#include "tagindex.h"
+
+struct TagTally;
 
 class DayEditor : public KTextEdit
 {
@@ -11,7 +17,14 @@ public:
     explicit DayEditor(const QDate &date, QWidget *parent = nullptr);
     
     QDate date() const { return m_date; }
+    int row() const { return m_row; }
+    void setRow(int row) { m_row = row; }
     void setContent(const QString &content);
+    void setDayContent(const DayContent &content);
+    QJsonObject stats() const;
+    void setCollapsedHeight(int height);
+    TagCounts tags() const;
+    bool isLoadingContent() const { return m_loadingContent; }
     QString content() const;
 
 public Q_SLOTS:
@@ -21,14 +34,32 @@ public Q_SLOTS:
 
 Q_SIGNALS:
     void navigate(bool forward);
+    void heightChanged(int height);
+    void tagsChanged();
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
     void focusOutEvent(QFocusEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
+    void insertFromMimeData(const QMimeData *source) override;
 
 private:
     QDate m_date;
+    int m_row;      // Index of the day in the DiaryModel, kept current by DiaryEditor
+    DayContent m_pendingPaste;
+    int m_pasteBlock;
+    int m_pasteOffset;
+    QTextCursor m_pasteCursor;
+    int m_collapsedHeight;
+    QSharedPointer<TagTally> m_tags;
+    quint64 m_tagRevision;
+    bool m_loadingContent;
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void setBlockTags(QTextBlock block, const QStringList &tags);
+    void emitTagsIfChanged();
+    void pasteNextChunk();
+    void finishPendingPaste();
     void updateGeometry();
     
     bool checkListContext();
@@ -5,17 +5,45 @@
 #include <QLabel>
 #include <QApplication>
 #include <QFontMetrics>
+#include <QScrollBar>
+#include <QResizeEvent>
+#include <QtConcurrent>
+#include <QJsonArray>
+#include <QFileInfo>
+#include "snapshotstore.h"
+#include "daycache.h"
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// Vertical gap inserted above each date header
+static const int DateHeaderSpacing = 10;
+
+// Layout items making up one day: spacing, date header and editor
+static const int LayoutItemsPerDay = 3;
+
+// Minimum time between two history snapshots taken on autosave
+static const qint64 SnapshotInterval = 15 * 60 * 1000;
 
 DiaryEditor::DiaryEditor(QWidget *parent)
     : QScrollArea(parent)
     , autoSaveTimer(new QTimer(this))
     , containerWidget(new QWidget(this))
     , layout(new QVBoxLayout(containerWidget))
+    , model(new DiaryModel(this))
+    , tags(new TagIndex(this))
+    , dateHeaderHeight(0)
+    , dayOverhead(0)
+    , collapsedHeight(600)
+    , pendingScrollRow(-1)
+    , pendingScrollBottom(false)
+    , pullingEdits(false)
 {
     // Set up content file location
-    QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    QDir().mkpath(dataPath);
-    contentFile = dataPath + QStringLiteral("/diary.md");
+    contentFile = defaultContentFile();
 
     // Setup scroll area
     setWidgetResizable(true);
@@ -25,6 +53,19 @@ DiaryEditor::DiaryEditor(QWidget *parent)
     layout->setSpacing(5);
     layout->setContentsMargins(10, 10, 10, 10);
     
+    // The widgets are views of the model's days and follow its changes
+    connect(model, &DiaryModel::dayInserted, this, &DiaryEditor::onDayInserted);
+    connect(model, &DiaryModel::dayChanged, this, &DiaryEditor::onDayChanged);
+    connect(model, &DiaryModel::modelReset, this, &DiaryEditor::onModelReset);
+    
+    // Re-apply a requested scroll position once the layout catches up
+    connect(verticalScrollBar(), &QScrollBar::rangeChanged, this, &DiaryEditor::onScrollRangeChanged);
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &DiaryEditor::materializeVisible);
+    connect(verticalScrollBar(), &QScrollBar::actionTriggered, this, [this]() {
+        pendingScrollRow = -1;
+        pendingScrollBottom = false;
+    });
+    
     loadContent();
     setupAutoSave();
 }
@@ -38,11 +79,91 @@ void DiaryEditor::loadContent()
     }
 }
 
+QString DiaryEditor::defaultContentFile()
+{
+    QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataPath);
+    return dataPath + QStringLiteral("/diary.md");
+}
+
+QString DiaryEditor::snapshotDirectory(const QString &contentFile)
+{
+    return QFileInfo(contentFile).absolutePath() + QStringLiteral("/snapshots");
+}
+
+QString DiaryEditor::sidecarFile(const QString &suffix) const
+{
+    QFileInfo info(contentFile);
+    return info.absolutePath() + QLatin1Char('/') + info.completeBaseName() + suffix;
+}
+
+void DiaryEditor::takeSnapshot()
+{
+    SnapshotStore store(snapshotDirectory(contentFile));
+    store.snapshot(*model);
+    lastSnapshot.start();
+}
+
 void DiaryEditor::parseContent(const QString &content)
+{
+    // Resetting the model rebuilds an empty view for every day
+    model->parse(content);
+    
+    // Days whose markdown hash is in the cache skip parsing entirely
+    DayCache cache(sidecarFile(QStringLiteral(".cache")));
+    cache.load();
+    
+    struct LoadedDay
+    {
+        QByteArray hash;
+        DayContent content;
+        QByteArray cacheData;   // Set when the day had to be parsed
+    };
+    
+    QList<int> rows;
+    rows.reserve(model->count());
+    for (int row = 0; row < model->count(); ++row)
+        rows.append(row);
+    
+    // Hash and convert day bodies across the thread pool; only the cheap
+    // step of filling each document has to happen on the GUI thread. The
+    // workers only read from the model, the hashes are stored afterwards.
+    const DiaryModel *days = model;
+    const QList<LoadedDay> parsed = QtConcurrent::blockingMapped<QList<LoadedDay>>(
+        rows, [days, &cache](int row) {
+            LoadedDay loaded;
+            const QByteArray &markdown = days->day(row).markdown;
+            loaded.hash = DiaryModel::hashMarkdown(markdown);
+            if (!cache.lookup(loaded.hash, loaded.content)) {
+                loaded.content = DayContent::fromMarkdown(QString::fromUtf8(markdown));
+                loaded.cacheData = DayCache::serialize(loaded.content);
+            }
+            return loaded;
+        });
+    
+    QSet<QByteArray> hashes;
+    hashes.reserve(parsed.size());
+    for (int row = 0; row < model->count(); ++row) {
+        const LoadedDay &loaded = parsed.at(row);
+        model->setContentHash(row, loaded.hash);
+        hashes.insert(loaded.hash);
+        if (!loaded.cacheData.isEmpty())
+            cache.insert(loaded.hash, loaded.cacheData);
+    }
+    cache.retainOnly(hashes);
+    if (cache.isModified())
+        cache.save();
+    
+    for (int row = 0; row < model->count(); ++row)
+        editors.value(model->day(row).date)->setDayContent(parsed.at(row).content);
+}
+
+void DiaryEditor::onModelReset()
 {
     // Clear existing editors
-    qDeleteAll(editors);
     editors.clear();
+    placeholders.clear();
+    restoreCache.reset();
     
     // Clear layout
     QLayoutItem *item;
@@ -50,43 +171,35 @@ void DiaryEditor::parseContent(const QString &content)
         delete item->widget();
         delete item;
     }
+    tags->clear();
     
-    QStringList lines = content.split(QStringLiteral("\n"));
-    QDate currentDate;
-    QString currentContent;
-    
-    for (const QString &line : lines) {
-        if (line.startsWith(QStringLiteral("# "))) {
-            // If we were building a section, create its editor
-            if (currentDate.isValid() && !currentContent.isEmpty()) {
-                DayEditor *editor = createDayEditor(currentDate);
-                editor->setContent(currentContent.trimmed());
-            }
-            
-            // Parse new date header
-            QString dateStr = line.mid(2).trimmed();
-            currentDate = QDate::fromString(dateStr, Qt::ISODate);
-            currentContent.clear();
-            
-            // Add date header label
-            if (currentDate.isValid()) {
-                addDateHeader(currentDate);
-            }
-        } else if (currentDate.isValid()) {
-            currentContent += line + QStringLiteral("\n");
-        }
-    }
-    
-    // Handle the last section
-    if (currentDate.isValid() && !currentContent.isEmpty()) {
-        DayEditor *editor = createDayEditor(currentDate);
-        editor->setContent(currentContent.trimmed());
-    }
+    // Build a view for every day in the model, in date order
+    for (int row = 0; row < model->count(); ++row)
+        addDayView(row);
     
     // Add stretch at the end
     layout->addStretch();
 }
 
+void DiaryEditor::onDayInserted(int row)
+{
+    // Days after the new one move down a row
+    for (DayEditor *editor : std::as_const(editors)) {
+        if (editor->row() >= row)
+            editor->setRow(editor->row() + 1);
+    }
+    addDayView(row);
+}
+
+void DiaryEditor::onDayChanged(int row)
+{
+    // Text pulled from an editor is already shown; anything else is reloaded
+    if (pullingEdits)
+        return;
+    if (DayEditor *editor = editors.value(model->day(row).date))
+        editor->setContent(QString::fromUtf8(model->day(row).markdown));
+}
+
 void DiaryEditor::saveContent()
 {
     QString content = serializeContent();
@@ -94,20 +207,33 @@ void DiaryEditor::saveContent()
     QFile file(contentFile);
     if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
         file.write(content.toUtf8());
+        file.close();
+        
+        if (!lastSnapshot.isValid() || lastSnapshot.hasExpired(SnapshotInterval))
+            takeSnapshot();
     }
 }
 
-QString DiaryEditor::serializeContent() const
+void DiaryEditor::syncModel()
 {
-    QString result;
-    QMapIterator<QDate, DayEditor*> it(editors);
-    while (it.hasNext()) {
-        it.next();
-        result += QStringLiteral("# %1\n\n").arg(it.key().toString(Qt::ISODate));
-        result += it.value()->content();
-        result += QStringLiteral("\n\n");
+    // Pull edits back from the views; untouched days keep their stored markdown
+    for (int row = 0; row < model->count(); ++row) {
+        const DayRecord &record = model->day(row);
+        if (!record.dirty)
+            continue;
+        if (DayEditor *editor = editors.value(record.date)) {
+            pullingEdits = true;
+            model->setMarkdown(row, editor->content().toUtf8());
+            pullingEdits = false;
+        }
+        model->setDirty(row, false);
     }
-    return result;
+}
+
+QString DiaryEditor::serializeContent()
+{
+    syncModel();
+    return model->serialize();
 }
 
 void DiaryEditor::checkAndUpdateDate()
@@ -118,17 +244,16 @@ void DiaryEditor::checkAndUpdateDate()
     
     QDate currentDate = QDate::currentDate();
     if (!hasSection(currentDate)) {
-        addDateHeader(currentDate);
-        createDayEditor(currentDate);
+        model->insertDay(currentDate);
     }
 }
 
 bool DiaryEditor::hasSection(const QDate &date) const
 {
-    return editors.contains(date);
+    return model->contains(date);
 }
 
-void DiaryEditor::addDateHeader(const QDate &date)
+QLabel* DiaryEditor::newDateHeader(const QDate &date)
 {
     QLabel *dateLabel = new QLabel(date.toString(Qt::ISODate), containerWidget);
     dateLabel->setAlignment(Qt::AlignLeft);
@@ -149,23 +274,150 @@ void DiaryEditor::addDateHeader(const QDate &date)
     // Add bottom border
     dateLabel->setStyleSheet(QStringLiteral("QLabel { border-bottom: 1px solid rgba(128, 128, 128, 0.3); }"));
     
-    // Add some vertical spacing
-    layout->addSpacing(10);
-    layout->addWidget(dateLabel);
+    if (dateHeaderHeight == 0) {
+        dateHeaderHeight = dateLabel->sizeHint().height();
+        
+        // Spacer, header and the layout gaps around the header; the box
+        // layout adds no spacing next to the spacer. This is only an
+        // estimate until calibrateDayGeometry() measures a laid out day.
+        dayOverhead = DateHeaderSpacing + dateHeaderHeight + 2 * layout->spacing();
+    }
+    
+    return dateLabel;
+}
+
+DayEditor* DiaryEditor::addDayView(int row)
+{
+    // Spacing, header and editor go at the day's place in date order, so
+    // the layout matches the model even when later days already exist
+    const QDate date = model->day(row).date;
+    const int index = qMin(row * LayoutItemsPerDay, insertionIndex());
+    layout->insertSpacing(index, DateHeaderSpacing);
+    layout->insertWidget(index + 1, newDateHeader(date));
+    DayEditor *editor = newDayEditor(row);
+    layout->insertWidget(index + 2, editor);
+    return editor;
+}
+
+int DiaryEditor::insertionIndex() const
+{
+    // Nothing goes below the trailing stretch
+    int count = layout->count();
+    if (count > 0) {
+        QLayoutItem *last = layout->itemAt(count - 1);
+        if (last->spacerItem() && (last->expandingDirections() & Qt::Vertical))
+            return count - 1;
+    }
+    return count;
 }
 
 DayEditor* DiaryEditor::createDayEditor(const QDate &date)
 {
+    // Inserting the day into the model creates its header and editor
+    int row = model->indexOf(date);
+    if (row < 0)
+        row = model->insertDay(date);
+    return editorForRow(row);
+}
+
+DayEditor* DiaryEditor::newDayEditor(int row)
+{
+    const QDate date = model->day(row).date;
     DayEditor *editor = new DayEditor(date, containerWidget);
-    editors[date] = editor;
-    layout->addWidget(editor);
+    editor->setRow(row);
+    editor->setCollapsedHeight(collapsedHeight);
+    editors.insert(date, editor);
     
     connect(editor, &DayEditor::textChanged, this, &DiaryEditor::onEditorChanged);
     connect(editor, &DayEditor::navigate, this, &DiaryEditor::onNavigate);
+    connect(editor, &DayEditor::heightChanged, this, &DiaryEditor::onEditorHeightChanged);
+    connect(editor, &DayEditor::tagsChanged, this, &DiaryEditor::onEditorTagsChanged);
+    connect(editor, &DayEditor::cursorPositionChanged, this, &DiaryEditor::onEditorCursorMoved);
+    
+    return editor;
+}
+
+DayEditor* DiaryEditor::editorForRow(int row)
+{
+    const DayRecord &record = model->day(row);
+    if (DayEditor *editor = editors.value(record.date))
+        return editor;
+    
+    QWidget *placeholder = placeholders.take(record.date);
+    if (!placeholder)
+        return nullptr;
+    
+    // Rebuild the day in place of the placeholder, from the parse cache
+    // when its markdown is unchanged. The cache is read once and kept
+    // only while released days remain.
+    if (!restoreCache) {
+        restoreCache.reset(new DayCache(sidecarFile(QStringLiteral(".cache"))));
+        restoreCache->load();
+    }
+    DayContent content;
+    if (!restoreCache->lookup(model->contentHash(row), content))
+        content = DayContent::fromMarkdown(QString::fromUtf8(record.markdown));
+    if (placeholders.isEmpty())
+        restoreCache.reset();
     
+    DayEditor *editor = newDayEditor(row);
+    editor->setDayContent(content);
+    delete layout->replaceWidget(placeholder, editor);
+    delete placeholder;
     return editor;
 }
 
+void DiaryEditor::trimMemory(int recentDays)
+{
+    const qint64 rssBefore = residentMemory();
+    
+    // Make sure the model holds every edit before any editor goes away
+    syncModel();
+    restoreCache.reset();
+    
+    int released = 0;
+    const int firstRecent = model->count() - recentDays;
+    for (int row = 0; row < firstRecent; ++row) {
+        const QDate date = model->day(row).date;
+        DayEditor *editor = editors.value(date);
+        if (!editor || editor->hasFocus())
+            continue;
+        
+        // Keep the day's exact height so scroll offsets don't move
+        QWidget *placeholder = new QWidget(containerWidget);
+        placeholder->setFixedHeight(editor->maximumHeight());
+        
+        editors.remove(date);
+        disconnect(editor, nullptr, this, nullptr);
+        delete layout->replaceWidget(editor, placeholder);
+        delete editor;
+        placeholders.insert(date, placeholder);
+        ++released;
+    }
+    
+#ifdef __GLIBC__
+    // Hand the freed heap back to the OS instead of keeping it mapped
+    malloc_trim(0);
+#endif
+    
+    lastTrim = QJsonObject();
+    lastTrim[QStringLiteral("rssBeforeBytes")] = rssBefore;
+    lastTrim[QStringLiteral("rssAfterBytes")] = residentMemory();
+    lastTrim[QStringLiteral("daysReleased")] = released;
+}
+
+void DiaryEditor::materializeVisible()
+{
+    if (placeholders.isEmpty() || model->isEmpty())
+        return;
+    
+    const int top = verticalScrollBar()->value() - layout->contentsMargins().top();
+    const int first = model->rowAt(qMax(0, top));
+    const int last = model->rowAt(qMax(0, top + viewport()->height()));
+    for (int row = first; row <= last; ++row)
+        editorForRow(row);
+}
+
 DayEditor* DiaryEditor::getCurrentEditor()
 {
     QWidget *focused = QApplication::focusWidget();
@@ -197,6 +449,61 @@ void DiaryEditor::toggleUnderline()
     }
 }
 
+QJsonObject DiaryEditor::stats() const
+{
+    static const QStringList counters = {
+        QStringLiteral("characters"), QStringLiteral("blocks"), QStringLiteral("fragments"),
+        QStringLiteral("undoSteps"), QStringLiteral("layoutLines"), QStringLiteral("widgets"),
+    };
+    
+    QJsonArray days;
+    QHash<QString, qint64> totals;
+    qint64 markdownBytes = 0;
+    for (int row = 0; row < model->count(); ++row) {
+        const DayRecord &record = model->day(row);
+        QJsonObject day;
+        if (DayEditor *editor = editors.value(record.date)) {
+            day = editor->stats();
+            for (const QString &counter : counters)
+                totals[counter] += day.value(counter).toInteger();
+        } else {
+            day[QStringLiteral("date")] = record.date.toString(Qt::ISODate);
+        }
+        day[QStringLiteral("markdownBytes")] = record.markdown.size();
+        markdownBytes += record.markdown.size();
+        days.append(day);
+    }
+    
+    QJsonObject total;
+    for (const QString &counter : counters)
+        total[counter] = totals.value(counter);
+    total[QStringLiteral("markdownBytes")] = markdownBytes;
+    total[QStringLiteral("days")] = model->count();
+    total[QStringLiteral("editors")] = int(editors.size());
+    
+    QJsonObject result;
+    result[QStringLiteral("rssBytes")] = residentMemory();
+    if (!lastTrim.isEmpty())
+        result[QStringLiteral("lastTrim")] = lastTrim;
+    result[QStringLiteral("total")] = total;
+    result[QStringLiteral("days")] = days;
+    return result;
+}
+
+qint64 DiaryEditor::residentMemory()
+{
+#ifdef Q_OS_UNIX
+    // Second field of statm is the resident set size in pages
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1)
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return -1;
+}
+
 void DiaryEditor::setupAutoSave()
 {
     // Save after 3 seconds of inactivity
@@ -207,15 +514,23 @@ void DiaryEditor::setupAutoSave()
 
 void DiaryEditor::onEditorChanged()
 {
+    // Every real edit counts, including one that undoes back to the
+    // loaded text after an autosave already stored the change
+    DayEditor *editor = qobject_cast<DayEditor*>(sender());
+    if (!editor || editor->isLoadingContent())
+        return;
+    
+    model->setDirty(editor->row(), true);
+    
     // Restart inactivity timer
     autoSaveTimer->start();
 }
 
 DayEditor* DiaryEditor::getLatestEditor() const
 {
-    if (editors.isEmpty())
+    if (model->isEmpty())
         return nullptr;
-    return editors.last();
+    return editors.value(model->day(model->count() - 1).date);
 }
 
 void DiaryEditor::onNavigate(bool forward)
@@ -225,38 +540,150 @@ void DiaryEditor::onNavigate(bool forward)
         return;
     }
 
-    // Find the current editor's date
-    QDate currentDate;
-    for (auto it = editors.begin(); it != editors.end(); ++it) {
-        if (it.value() == current) {
-            currentDate = it.key();
-            break;
-        }
+    // Get the next/previous editor
+    int row = current->row() + (forward ? 1 : -1);
+    if (row < 0 || row >= model->count()) {
+        return;
+    }
+    
+    DayEditor *target = editorForRow(row);
+    if (!target) {
+        return;
     }
+    
+    target->setFocus();
+    QTextCursor cursor = target->textCursor();
+    cursor.movePosition(forward ? QTextCursor::Start : QTextCursor::End);
+    target->setTextCursor(cursor);
+    pendingScrollRow = -1;
+    pendingScrollBottom = false;
+    ensureDayVisible(row);
+}
+
+void DiaryEditor::onEditorHeightChanged(int height)
+{
+    if (DayEditor *editor = qobject_cast<DayEditor*>(sender()))
+        model->setHeight(editor->row(), height + dayOverhead);
+}
 
-    if (!currentDate.isValid()) {
+QWidget* DiaryEditor::dayWidget(int row) const
+{
+    const QDate date = model->day(row).date;
+    if (DayEditor *editor = editors.value(date))
+        return editor;
+    return placeholders.value(date);
+}
+
+void DiaryEditor::calibrateDayGeometry()
+{
+    if (model->count() < 2)
         return;
+    
+    // Once two days are laid out, the gap between their editors is exactly
+    // what every day adds on top of its editor's height
+    QWidget *first = dayWidget(0);
+    QWidget *second = dayWidget(1);
+    if (!first || !second || first->height() != first->maximumHeight() || second->y() <= first->y())
+        return;
+    
+    const int overhead = second->y() - first->y() - first->height();
+    if (overhead == dayOverhead)
+        return;
+    for (int row = 0; row < model->count(); ++row) {
+        const int height = model->day(row).height;
+        if (height > 0)
+            model->setHeight(row, height - dayOverhead + overhead);
     }
+    dayOverhead = overhead;
+}
+
+void DiaryEditor::resizeEvent(QResizeEvent *event)
+{
+    QScrollArea::resizeEvent(event);
+    materializeVisible();
     
-    // Get the next/previous editor
-    auto it = editors.find(currentDate);
-    if (forward) {
-        ++it;
-        if (it != editors.end()) {
-            it.value()->setFocus();
-            QTextCursor cursor = it.value()->textCursor();
-            cursor.movePosition(QTextCursor::Start);
-            it.value()->setTextCursor(cursor);
-            ensureWidgetVisible(it.value());
-        }
-    } else {
-        if (it != editors.begin()) {
-            --it;
-            it.value()->setFocus();
-            QTextCursor cursor = it.value()->textCursor();
-            cursor.movePosition(QTextCursor::End);
-            it.value()->setTextCursor(cursor);
-            ensureWidgetVisible(it.value());
+    // Giant days collapse to the view's height and scroll internally
+    if (viewport()->height() != collapsedHeight) {
+        collapsedHeight = viewport()->height();
+        for (DayEditor *editor : std::as_const(editors))
+            editor->setCollapsedHeight(collapsedHeight);
+    }
+}
+
+void DiaryEditor::onEditorCursorMoved()
+{
+    // Once the user clicks or types somewhere, a scroll target chosen
+    // earlier must not pull the view away from them as the layout grows
+    if (DayEditor *editor = qobject_cast<DayEditor*>(sender())) {
+        if (editor->hasFocus()) {
+            pendingScrollRow = -1;
+            pendingScrollBottom = false;
         }
     }
 }
+
+void DiaryEditor::onEditorTagsChanged()
+{
+    if (DayEditor *editor = qobject_cast<DayEditor*>(sender()))
+        tags->setDayTags(editor->date(), editor->tags());
+}
+
+int DiaryEditor::dayTop(int row) const
+{
+    return layout->contentsMargins().top() + model->offsetOf(row);
+}
+
+void DiaryEditor::scrollToRow(int row)
+{
+    pendingScrollRow = row;
+    pendingScrollBottom = false;
+    verticalScrollBar()->setValue(dayTop(row));
+}
+
+void DiaryEditor::ensureDayVisible(int row)
+{
+    int top = dayTop(row);
+    int bottom = top + model->day(row).height;
+    QScrollBar *bar = verticalScrollBar();
+    int viewHeight = viewport()->height();
+    
+    if (top < bar->value() || bottom - top > viewHeight) {
+        bar->setValue(top);
+    } else if (bottom > bar->value() + viewHeight) {
+        bar->setValue(bottom - viewHeight);
+    }
+}
+
+void DiaryEditor::scrollToBottom()
+{
+    pendingScrollRow = -1;
+    pendingScrollBottom = true;
+    verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+}
+
+void DiaryEditor::jumpToDate(const QDate &date)
+{
+    if (model->isEmpty())
+        return;
+    
+    // Land on the requested day, or the first one after it
+    int row = qMin(model->lowerBound(date), model->count() - 1);
+    if (DayEditor *target = editorForRow(row)) {
+        target->setFocus();
+        QTextCursor cursor = target->textCursor();
+        cursor.movePosition(QTextCursor::Start);
+        target->setTextCursor(cursor);
+    }
+    scrollToRow(row);
+}
+
+void DiaryEditor::onScrollRangeChanged()
+{
+    calibrateDayGeometry();
+    if (pendingScrollBottom) {
+        verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+    } else if (pendingScrollRow >= 0 && pendingScrollRow < model->count()) {
+        verticalScrollBar()->setValue(dayTop(pendingScrollRow));
+    }
+    materializeVisible();
+}
@@ -3,9 +3,17 @@
 #include <QScrollArea>
 #include <QVBoxLayout>
 #include <QTimer>
-#include <QMap>
+#include <QHash>
 #include <QDate>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <QScopedPointer>
 #include "dayeditor.h"
+#include "diarymodel.h"
+#include "tagindex.h"
+#include "daycache.h"
+
+class QLabel;
 
 class DiaryEditor : public QScrollArea
 {
@@ -15,35 +23,80 @@ public:
     DiaryEditor(QWidget *parent = nullptr);
     void saveContent();
     void loadContent();
+    void takeSnapshot();
     void setContentFile(const QString &path) { contentFile = path; }
+    DiaryModel *diaryModel() const { return model; }
+    TagIndex *tagIndex() const { return tags; }
+    QJsonObject stats() const;
+    void trimMemory(int recentDays);
+    void materializeVisible();
+    static qint64 residentMemory();
+    static QString defaultContentFile();
+    static QString snapshotDirectory(const QString &contentFile);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
 
 public Q_SLOTS:
     void toggleBold();
     void toggleItalic();
     void toggleUnderline();
+    void scrollToBottom();
+    void jumpToDate(const QDate &date);
 
 private:
     QString contentFile;
     QTimer *autoSaveTimer;
     QWidget *containerWidget;
     QVBoxLayout *layout;
-    QMap<QDate, DayEditor*> editors;
+    DiaryModel *model;
+    TagIndex *tags;
+    QHash<QDate, DayEditor*> editors;
+    QHash<QDate, QWidget*> placeholders;
+    QScopedPointer<DayCache> restoreCache;
+    QJsonObject lastTrim;
+    int dateHeaderHeight;
+    int dayOverhead;
+    int collapsedHeight;
+    int pendingScrollRow;
+    bool pendingScrollBottom;
+    bool pullingEdits;
+    QElapsedTimer lastSnapshot;
+
+    void syncModel();
+    QString sidecarFile(const QString &suffix) const;
+    int insertionIndex() const;
+    QLabel* newDateHeader(const QDate &date);
+    DayEditor* addDayView(int row);
+    DayEditor* newDayEditor(int row);
+    DayEditor* editorForRow(int row);
+    QWidget* dayWidget(int row) const;
+    void calibrateDayGeometry();
+    void scrollToRow(int row);
+    void ensureDayVisible(int row);
     
 public:
     void checkAndUpdateDate();
     bool skipDateHeader() const { return property("skipDateHeader").toBool(); }
     void parseContent(const QString &content);
-    QString serializeContent() const;
+    QString serializeContent();
     bool hasSection(const QDate &date) const;
     void setupAutoSave();
     DayEditor* getCurrentEditor();
+    int dayTop(int row) const;
 
 public:
-    void addDateHeader(const QDate &date);
     DayEditor* getLatestEditor() const;
     DayEditor* createDayEditor(const QDate &date);
 
 private Q_SLOTS:
+    void onModelReset();
+    void onDayInserted(int row);
+    void onDayChanged(int row);
     void onEditorChanged();
     void onNavigate(bool forward);
+    void onEditorHeightChanged(int height);
+    void onEditorTagsChanged();
+    void onEditorCursorMoved();
+    void onScrollRangeChanged();
 };
@@ -0,0 +1,279 @@
+#include "diaryimporter.h"
+#include "diarymodel.h"
+#include "snapshotstore.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <algorithm>
+#include <utility>
+
+DiaryImporter::DiaryImporter(const QString &sourceDirectory)
+    : directory(sourceDirectory)
+    , files(0)
+    , skipped(0)
+    , days(0)
+    , merged(0)
+    , bytes(0)
+    , elapsed(0)
+{
+}
+
+// Bring one day's text into the diary's format: no front matter, and no
+// "# " lines, which would otherwise be read back as day headers
+static QByteArray normalizeBody(const QString &text, const QDate &date)
+{
+    QStringList lines = text.split(QLatin1Char('\n'));
+
+    if (!lines.isEmpty() && lines.first().trimmed() == QLatin1String("---")) {
+        for (int i = 1; i < lines.size(); ++i) {
+            if (lines.at(i).trimmed() == QLatin1String("---")) {
+                lines.erase(lines.begin(), lines.begin() + i + 1);
+                break;
+            }
+        }
+    }
+
+    const QString isoDate = date.toString(Qt::ISODate);
+    bool seenText = false;
+    bool afterHeading = false;
+    QStringList result;
+    for (const QString &line : std::as_const(lines)) {
+        if (line.startsWith(QLatin1String("# "))) {
+            const QString title = line.mid(2).trimmed();
+            // A leading heading that only repeats the date is redundant
+            if (!seenText && title.contains(isoDate))
+                continue;
+            // Single newlines fold into spaces, so the bold line needs a
+            // paragraph of its own to stay on its own line
+            if (!result.isEmpty() && !result.last().trimmed().isEmpty())
+                result.append(QString());
+            result.append(title.isEmpty() ? QString() : QStringLiteral("**%1**").arg(title));
+            afterHeading = !title.isEmpty();
+        } else {
+            if (afterHeading && !line.trimmed().isEmpty())
+                result.append(QString());
+            afterHeading = false;
+            result.append(line);
+        }
+        seenText = seenText || !line.trimmed().isEmpty();
+    }
+    return result.join(QLatin1Char('\n')).trimmed().toUtf8();
+}
+
+static QDate matchDate(const QRegularExpression &pattern, const QString &subject)
+{
+    QRegularExpressionMatch match = pattern.match(subject);
+    if (!match.hasMatch())
+        return QDate();
+    return QDate(match.captured(1).toInt(), match.captured(2).toInt(), match.captured(3).toInt());
+}
+
+static QDate dateFromPath(const QString &relativePath)
+{
+    // Prefer a date in the file name, then a year/month/day folder layout
+    const QRegularExpression nameDate(QStringLiteral("(\\d{4})[-_.]?(\\d{2})[-_.]?(\\d{2})"));
+    QDate date = matchDate(nameDate, relativePath.section(QLatin1Char('/'), -1));
+    if (date.isValid())
+        return date;
+
+    const QRegularExpression folderDate(QStringLiteral("(\\d{4})/(\\d{2})/(\\d{2})"));
+    return matchDate(folderDate, relativePath);
+}
+
+QList<ImportedDay> DiaryImporter::parseFile(const QString &path, const QString &relativePath)
+{
+    QList<ImportedDay> result;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return result;
+    QString text = QString::fromUtf8(file.readAll());
+    text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+
+    // Files already in this diary's "# YYYY-MM-DD" section format
+    const QRegularExpression sectionHeader(QStringLiteral("^# \\d{4}-\\d{2}-\\d{2}\\s*$"),
+                                           QRegularExpression::MultilineOption);
+    if (sectionHeader.match(text).hasMatch()) {
+        QDate current;
+        QStringList body;
+        auto flush = [&]() {
+            if (current.isValid())
+                result.append(ImportedDay{current, normalizeBody(body.join(QLatin1Char('\n')), current)});
+            body.clear();
+        };
+        const QStringList lines = text.split(QLatin1Char('\n'));
+        for (const QString &line : lines) {
+            const QDate date = line.startsWith(QLatin1String("# "))
+                ? QDate::fromString(line.mid(2).trimmed(), Qt::ISODate)
+                : QDate();
+            if (date.isValid()) {
+                flush();
+                current = date;
+            } else {
+                body.append(line);
+            }
+        }
+        flush();
+        return result;
+    }
+
+    // jrnl-style exports: "[YYYY-MM-DD HH:MM] Title" starts each entry
+    const QRegularExpression entryHeader(
+        QStringLiteral("^\\[?(\\d{4}-\\d{2}-\\d{2})[ T]\\d{2}:\\d{2}(?::\\d{2})?\\]?[ \\t]*(.*)$"),
+        QRegularExpression::MultilineOption);
+    QRegularExpressionMatch first = entryHeader.match(text);
+    if (first.hasMatch() && text.left(first.capturedStart()).trimmed().isEmpty()) {
+        QRegularExpressionMatchIterator it = entryHeader.globalMatch(text);
+        QRegularExpressionMatch match = it.next();
+        while (match.hasMatch()) {
+            QRegularExpressionMatch next = it.hasNext() ? it.next() : QRegularExpressionMatch();
+            const int bodyEnd = next.hasMatch() ? next.capturedStart() : text.size();
+            const QDate date = QDate::fromString(match.captured(1), Qt::ISODate);
+            if (date.isValid()) {
+                QString entry = text.mid(match.capturedEnd(), bodyEnd - match.capturedEnd()).trimmed();
+                const QString title = match.captured(2).trimmed();
+                if (!title.isEmpty())
+                    entry.prepend(title + QStringLiteral("\n\n"));
+                result.append(ImportedDay{date, normalizeBody(entry, date)});
+            }
+            match = next;
+        }
+        return result;
+    }
+
+    // One note per file, dated by its path
+    const QDate date = dateFromPath(relativePath);
+    if (date.isValid())
+        result.append(ImportedDay{date, normalizeBody(text, date)});
+    return result;
+}
+
+// Whether entry already makes up whole paragraphs of existing. Imported
+// entries are always appended on a paragraph break, so a match has to
+// start and end on one; a mere substring may be part of another note.
+static bool containsEntry(const QByteArray &existing, const QByteArray &entry)
+{
+    qsizetype from = 0;
+    while ((from = existing.indexOf(entry, from)) >= 0) {
+        const qsizetype end = from + entry.size();
+        const bool startsParagraph = from == 0 || (from >= 2 && existing.mid(from - 2, 2) == "\n\n");
+        const bool endsParagraph = end == existing.size() || existing.mid(end, 2) == "\n\n";
+        if (startsParagraph && endsParagraph)
+            return true;
+        ++from;
+    }
+    return false;
+}
+
+int DiaryImporter::merge(DiaryModel &model, const QList<ImportedDay> &imported)
+{
+    int mergedDays = 0;
+    for (const ImportedDay &day : imported) {
+        if (day.markdown.isEmpty())
+            continue;
+
+        int row = model.indexOf(day.date);
+        if (row < 0) {
+            model.insertDay(day.date, day.markdown);
+            continue;
+        }
+
+        // Importing the same notes twice must not duplicate them
+        const QByteArray &existing = model.day(row).markdown;
+        if (containsEntry(existing, day.markdown))
+            continue;
+        QByteArray combined = existing;
+        if (!combined.isEmpty())
+            combined += "\n\n";
+        combined += day.markdown;
+        model.setMarkdown(row, combined);
+        ++mergedDays;
+    }
+    return mergedDays;
+}
+
+bool DiaryImporter::importInto(const QString &contentFile, const QString &snapshotDirectory)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    struct Source
+    {
+        QString path;
+        QString relativePath;
+    };
+    struct Parsed
+    {
+        QList<ImportedDay> days;
+        qint64 bytes = 0;
+    };
+
+    const QDir base(directory);
+    if (!base.exists()) {
+        error = QStringLiteral("Directory %1 does not exist").arg(directory);
+        return false;
+    }
+
+    QList<Source> sources;
+    QDirIterator it(directory, {QStringLiteral("*.md"), QStringLiteral("*.markdown"), QStringLiteral("*.txt")},
+                    QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString path = it.next();
+        sources.append(Source{path, base.relativeFilePath(path)});
+    }
+    // A stable order keeps merges of several files into one day reproducible
+    std::sort(sources.begin(), sources.end(), [](const Source &a, const Source &b) {
+        return a.relativePath < b.relativePath;
+    });
+
+    const QList<Parsed> parsed = QtConcurrent::blockingMapped<QList<Parsed>>(sources, [](const Source &source) {
+        Parsed result;
+        result.bytes = QFileInfo(source.path).size();
+        result.days = parseFile(source.path, source.relativePath);
+        return result;
+    });
+
+    DiaryModel model;
+    QFile existing(contentFile);
+    if (existing.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        model.parse(QString::fromUtf8(existing.readAll()));
+        existing.close();
+
+        // The diary as it was before the import stays restorable
+        if (!snapshotDirectory.isEmpty())
+            SnapshotStore(snapshotDirectory).snapshot(model);
+    }
+
+    files = sources.size();
+    skipped = 0;
+    days = 0;
+    merged = 0;
+    bytes = 0;
+    for (const Parsed &result : parsed) {
+        bytes += result.bytes;
+        if (result.days.isEmpty()) {
+            ++skipped;
+            continue;
+        }
+        days += result.days.size();
+        merged += merge(model, result.days);
+    }
+
+    QSaveFile out(contentFile);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        error = out.errorString();
+        return false;
+    }
+    out.write(model.serialize().toUtf8());
+    if (!out.commit()) {
+        error = out.errorString();
+        return false;
+    }
+
+    elapsed = timer.elapsed();
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDate>
+#include <QList>
+#include <QString>
+
+class DiaryModel;
+
+struct ImportedDay
+{
+    QDate date;
+    QByteArray markdown;
+};
+
+// Bulk import of daily-note files into the diary, without any widgets.
+// Files are found up front, parsed and normalized to day sections across
+// the thread pool, merged into the existing days by date and written back
+// in one atomic save.
+class DiaryImporter
+{
+public:
+    explicit DiaryImporter(const QString &directory);
+
+    bool importInto(const QString &contentFile, const QString &snapshotDirectory = QString());
+    QString errorString() const { return error; }
+
+    int fileCount() const { return files; }
+    int skippedCount() const { return skipped; }
+    int dayCount() const { return days; }
+    int mergedCount() const { return merged; }
+    qint64 byteCount() const { return bytes; }
+    qint64 elapsedMs() const { return elapsed; }
+
+    static QList<ImportedDay> parseFile(const QString &path, const QString &relativePath);
+    static int merge(DiaryModel &model, const QList<ImportedDay> &imported);
+
+private:
+    QString directory;
+    QString error;
+    int files;
+    int skipped;
+    int days;
+    int merged;
+    qint64 bytes;
+    qint64 elapsed;
+};
@@ -0,0 +1,161 @@
+#include "diarymodel.h"
+#include <QCryptographicHash>
+#include <algorithm>
+
+DiaryModel::DiaryModel(QObject *parent)
+    : QObject(parent)
+{
+}
+
+int DiaryModel::lowerBound(const QDate &date) const
+{
+    auto it = std::lower_bound(days.cbegin(), days.cend(), date,
+                               [](const DayRecord &record, const QDate &d) { return record.date < d; });
+    return int(it - days.cbegin());
+}
+
+int DiaryModel::indexOf(const QDate &date) const
+{
+    int row = lowerBound(date);
+    if (row < days.size() && days.at(row).date == date)
+        return row;
+    return -1;
+}
+
+int DiaryModel::insertDay(const QDate &date, const QByteArray &markdown)
+{
+    int row = lowerBound(date);
+    if (row < days.size() && days.at(row).date == date) {
+        // Duplicate sections for the same date are merged rather than dropped
+        if (!markdown.isEmpty()) {
+            DayRecord &record = days[row];
+            if (!record.markdown.isEmpty())
+                record.markdown += "\n\n";
+            record.markdown += markdown;
+            record.hash.clear();
+            Q_EMIT dayChanged(row);
+        }
+        return row;
+    }
+
+    DayRecord record;
+    record.date = date;
+    record.markdown = markdown;
+    days.insert(row, record);
+    heights.insert(row, 0);
+    Q_EMIT dayInserted(row);
+    return row;
+}
+
+void DiaryModel::setMarkdown(int row, const QByteArray &markdown)
+{
+    DayRecord &record = days[row];
+    if (record.markdown == markdown)
+        return;
+    record.markdown = markdown;
+    record.hash.clear();
+    Q_EMIT dayChanged(row);
+}
+
+QByteArray DiaryModel::hashMarkdown(const QByteArray &markdown)
+{
+    return QCryptographicHash::hash(markdown, QCryptographicHash::Sha256);
+}
+
+QByteArray DiaryModel::contentHash(int row) const
+{
+    const DayRecord &record = days.at(row);
+    if (record.hash.isEmpty())
+        record.hash = hashMarkdown(record.markdown);
+    return record.hash;
+}
+
+void DiaryModel::setContentHash(int row, const QByteArray &hash)
+{
+    // For hashes computed elsewhere, e.g. in parallel while loading
+    days[row].hash = hash;
+}
+
+void DiaryModel::setDirty(int row, bool dirty)
+{
+    days[row].dirty = dirty;
+}
+
+void DiaryModel::setHeight(int row, int height)
+{
+    DayRecord &record = days[row];
+    if (record.height == height)
+        return;
+    record.height = height;
+    heights.set(row, height);
+}
+
+void DiaryModel::clear()
+{
+    days.clear();
+    heights.clear();
+    Q_EMIT modelReset();
+}
+
+void DiaryModel::parse(const QString &content)
+{
+    days.clear();
+
+    QDate currentDate;
+    QString currentContent;
+    bool hasContent = false;
+
+    auto flush = [&]() {
+        if (currentDate.isValid() && hasContent) {
+            int row = lowerBound(currentDate);
+            QByteArray markdown = currentContent.trimmed().toUtf8();
+            if (row < days.size() && days.at(row).date == currentDate) {
+                if (!days[row].markdown.isEmpty())
+                    days[row].markdown += "\n\n";
+                days[row].markdown += markdown;
+            } else {
+                DayRecord record;
+                record.date = currentDate;
+                record.markdown = markdown;
+                days.insert(row, record);
+            }
+        }
+    };
+
+    const QStringList lines = content.split(QLatin1Char('\n'));
+    for (const QString &line : lines) {
+        if (line.startsWith(QStringLiteral("# "))) {
+            flush();
+
+            // Parse new date header
+            currentDate = QDate::fromString(line.mid(2).trimmed(), Qt::ISODate);
+            currentContent.clear();
+            hasContent = false;
+        } else if (currentDate.isValid()) {
+            currentContent += line;
+            currentContent += QLatin1Char('\n');
+            hasContent = true;
+        }
+    }
+
+    // Handle the last section
+    flush();
+
+    heights.reset(QList<int>(days.size(), 0));
+
+    Q_EMIT modelReset();
+}
+
+QString DiaryModel::serialize() const
+{
+    QString result;
+    for (const DayRecord &record : days) {
+        // Days are created ahead of use, so one nobody wrote in isn't saved
+        if (record.markdown.isEmpty())
+            continue;
+        result += QStringLiteral("# %1\n\n").arg(record.date.toString(Qt::ISODate));
+        result += QString::fromUtf8(record.markdown);
+        result += QStringLiteral("\n\n");
+    }
+    return result;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QDate>
+#include <QList>
+#include "heightindex.h"
+
+struct DayRecord
+{
+    QDate date;
+    QByteArray markdown;    // Day body as compact UTF-8 markdown
+    bool dirty = false;     // Editor holds changes not yet written to disk
+    int height = 0;         // Last known on-screen height in pixels
+    mutable QByteArray hash;    // Cached content hash, empty until requested
+};
+
+// Owns the diary's day records, independent of any widgets.
+// Days are kept sorted by date in contiguous storage, so lookups by
+// date are binary searches and rows can be addressed directly.
+class DiaryModel : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DiaryModel(QObject *parent = nullptr);
+
+    int count() const { return days.size(); }
+    bool isEmpty() const { return days.isEmpty(); }
+    const DayRecord &day(int row) const { return days.at(row); }
+
+    int indexOf(const QDate &date) const;
+    int lowerBound(const QDate &date) const;
+    bool contains(const QDate &date) const { return indexOf(date) >= 0; }
+    QByteArray contentHash(int row) const;
+    void setContentHash(int row, const QByteArray &hash);
+    static QByteArray hashMarkdown(const QByteArray &markdown);
+
+    int insertDay(const QDate &date, const QByteArray &markdown = QByteArray());
+    void setMarkdown(int row, const QByteArray &markdown);
+    void setDirty(int row, bool dirty);
+    void setHeight(int row, int height);
+    void clear();
+
+    int offsetOf(int row) const { return heights.offsetOf(row); }
+    int totalHeight() const { return heights.total(); }
+    int rowAt(int offset) const { return heights.rowAt(offset); }
+
+    void parse(const QString &content);
+    QString serialize() const;
+
+Q_SIGNALS:
+    void dayInserted(int row);
+    void dayChanged(int row);
+    void modelReset();
+
+private:
+    QList<DayRecord> days;
+    HeightIndex heights;
+};
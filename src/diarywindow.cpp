@@ -5,20 +5,62 @@
 #include <QAction>
 #include <QApplication>
 #include <QMenu>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QPlainTextEdit>
+#include <QJsonDocument>
+#include <QDateTime>
+#include <QToolButton>
+#include <algorithm>
+
+// How long the window stays hidden before idle memory is trimmed
+static const int IdleTrimDelay = 5 * 60 * 1000;
+
+// Days kept fully loaded while trimming, counting back from the latest
+static const int RecentDaysKept = 7;
 
 DiaryWindow::DiaryWindow(QWidget *parent)
     : QWidget(parent, Qt::Tool | Qt::FramelessWindowHint)
+    , midnightTimer(new QTimer(this))
+    , trimTimer(new QTimer(this))
+    , activationLatency(-1)
 {
     setAttribute(Qt::WA_DeleteOnClose, false);
 
     setupUI();
     createActions();
+    
+    // Whatever is on disk at startup can always be restored later
+    if (!editor->diaryModel()->isEmpty())
+        editor->takeSnapshot();
+
+    // Keep the hidden window ready so activation only has to show it
+    midnightTimer->setSingleShot(true);
+    connect(midnightTimer, &QTimer::timeout, this, &DiaryWindow::onMidnight);
+    create();
+    prepareForShow();
+    scheduleMidnight();
+    
+    // Release what a hidden window doesn't need once it has been idle a while
+    trimTimer->setSingleShot(true);
+    trimTimer->setInterval(IdleTrimDelay);
+    connect(trimTimer, &QTimer::timeout, this, [this]() {
+        editor->trimMemory(RecentDaysKept);
+    });
+    trimTimer->start();
 
     // Set up system tray
     // Create context menu
     QMenu *trayMenu = new QMenu(this);
+    QAction *statsAction = trayMenu->addAction(tr("Memory Statistics..."));
+    connect(statsAction, &QAction::triggered, this, &DiaryWindow::showStats);
     QAction *quitAction = trayMenu->addAction(tr("Quit"));
     connect(quitAction, &QAction::triggered, qApp, &QApplication::quit);
+    
+    // Debug entry, only listed while Shift is held as the menu opens
+    connect(trayMenu, &QMenu::aboutToShow, this, [statsAction]() {
+        statsAction->setVisible(QGuiApplication::queryKeyboardModifiers() & Qt::ShiftModifier);
+    });
 
     trayIcon = new QSystemTrayIcon(QIcon::fromTheme(QStringLiteral("accessories-text-editor")), this);
     trayIcon->setToolTip(tr("KDailyNote"));
@@ -73,6 +115,86 @@ void DiaryWindow::createActions()
     QAction *underlineAction = toolbar->addAction(QIcon::fromTheme(QIcon::ThemeIcon::FormatTextUnderline),
                                                 tr("Underline"), editor, &DiaryEditor::toggleUnderline);
     underlineAction->setShortcut(QKeySequence::Underline);  // Ctrl+U
+    
+    toolbar->addSeparator();
+    
+    // Tag browser, rebuilt from the live index each time it opens
+    QMenu *tagMenu = new QMenu(this);
+    connect(tagMenu, &QMenu::aboutToShow, this, [this, tagMenu]() {
+        populateTagMenu(tagMenu);
+    });
+    QToolButton *tagButton = new QToolButton(toolbar);
+    tagButton->setIcon(QIcon::fromTheme(QStringLiteral("tag")));
+    tagButton->setText(tr("Tags"));
+    tagButton->setToolTip(tr("Browse tags and mentions"));
+    tagButton->setMenu(tagMenu);
+    tagButton->setPopupMode(QToolButton::InstantPopup);
+    toolbar->addWidget(tagButton);
+    
+    QAction *jumpAction = toolbar->addAction(QIcon::fromTheme(QStringLiteral("go-jump")),
+                                           tr("Jump to Date"), this, &DiaryWindow::showJumpToDate);
+    jumpAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_G));  // Ctrl+G
+    
+    // Inline date entry, shown only while jumping
+    jumpEdit = new QLineEdit(toolbar);
+    jumpEdit->setPlaceholderText(tr("YYYY-MM-DD"));
+    jumpEdit->setMaximumWidth(120);
+    jumpEditAction = toolbar->addWidget(jumpEdit);
+    jumpEditAction->setVisible(false);
+    connect(jumpEdit, &QLineEdit::returnPressed, this, &DiaryWindow::jumpToDate);
+    connect(jumpEdit, &QLineEdit::editingFinished, this, [this]() {
+        jumpEditAction->setVisible(false);
+    });
+}
+
+void DiaryWindow::populateTagMenu(QMenu *menu)
+{
+    menu->clear();
+    
+    const TagIndex *index = editor->tagIndex();
+    QStringList tags = index->tags();
+    if (tags.isEmpty()) {
+        menu->addAction(tr("No tags yet"))->setEnabled(false);
+        return;
+    }
+    
+    // Most used first
+    QHash<QString, int> counts;
+    for (const QString &tag : std::as_const(tags))
+        counts.insert(tag, index->count(tag));
+    std::stable_sort(tags.begin(), tags.end(), [&counts](const QString &a, const QString &b) {
+        return counts.value(a) > counts.value(b);
+    });
+    
+    for (const QString &tag : std::as_const(tags)) {
+        QMenu *dateMenu = menu->addMenu(QStringLiteral("%1 (%2)").arg(tag).arg(counts.value(tag)));
+        const QMap<QDate, int> dates = index->dates(tag);
+        for (auto it = dates.cend(); it != dates.cbegin();) {
+            --it;
+            const QDate date = it.key();
+            dateMenu->addAction(date.toString(Qt::ISODate), this, [this, date]() {
+                editor->jumpToDate(date);
+            });
+        }
+    }
+}
+
+void DiaryWindow::showJumpToDate()
+{
+    jumpEdit->setText(QDate::currentDate().toString(Qt::ISODate));
+    jumpEditAction->setVisible(true);
+    jumpEdit->selectAll();
+    jumpEdit->setFocus();
+}
+
+void DiaryWindow::jumpToDate()
+{
+    QDate date = QDate::fromString(jumpEdit->text().trimmed(), Qt::ISODate);
+    if (!date.isValid())
+        return;
+    
+    jumpEditAction->setVisible(false);
+    editor->jumpToDate(date);
 }
 
 void DiaryWindow::trayIconActivated(QSystemTrayIcon::ActivationReason reason)
@@ -81,26 +203,111 @@ void DiaryWindow::trayIconActivated(QSystemTrayIcon::ActivationReason reason)
         if (isVisible()) {
             hide();
         } else {
+            activationTimer.start();
+            trimTimer->stop();
+            
+            // The midnight timer may not have fired across a suspend
+            if (preparedDate != QDate::currentDate()) {
+                prepareForShow();
+            }
+            
             positionWindow();
             show();
             raise();
             activateWindow();
             
-            // Check if we need a new day and create it
-            editor->checkAndUpdateDate();
-            
-            // Focus and scroll to the latest day
             if (auto latestEditor = editor->getLatestEditor()) {
                 latestEditor->setFocus();
-                QTextCursor cursor = latestEditor->textCursor();
-                cursor.movePosition(QTextCursor::End);
-                latestEditor->setTextCursor(cursor);
-                editor->ensureWidgetVisible(latestEditor);
             }
         }
     }
 }
 
+QJsonObject DiaryWindow::stats() const
+{
+    QJsonObject result = editor->stats();
+    if (activationLatency >= 0)
+        result[QStringLiteral("activationLatencyMs")] = activationLatency;
+    return result;
+}
+
+void DiaryWindow::showStats()
+{
+    QDialog *dialog = new QDialog();
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowTitle(tr("KDailyNote Memory Statistics"));
+    
+    QPlainTextEdit *view = new QPlainTextEdit(dialog);
+    view->setReadOnly(true);
+    view->setLineWrapMode(QPlainTextEdit::NoWrap);
+    view->setPlainText(QString::fromUtf8(QJsonDocument(stats()).toJson(QJsonDocument::Indented)));
+    
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, dialog);
+    connect(buttons, &QDialogButtonBox::rejected, dialog, &QDialog::close);
+    
+    QVBoxLayout *layout = new QVBoxLayout(dialog);
+    layout->addWidget(view);
+    layout->addWidget(buttons);
+    
+    dialog->resize(500, 600);
+    dialog->show();
+}
+
+void DiaryWindow::prepareForShow()
+{
+    // Check if we need a new day and create it
+    editor->checkAndUpdateDate();
+    preparedDate = QDate::currentDate();
+    
+    // Place the cursor at the end of the latest day and decide the scroll
+    // position now, rather than between the click and the first frame
+    if (auto latestEditor = editor->getLatestEditor()) {
+        QTextCursor cursor = latestEditor->textCursor();
+        cursor.movePosition(QTextCursor::End);
+        latestEditor->setTextCursor(cursor);
+        latestEditor->setFocus();
+    }
+    editor->scrollToBottom();
+    
+    editor->widget()->layout()->activate();
+    layout()->activate();
+}
+
+void DiaryWindow::scheduleMidnight()
+{
+    // Fire shortly after midnight so the new day exists before it is needed
+    QDateTime nextMidnight(QDate::currentDate().addDays(1), QTime(0, 0));
+    qint64 msecs = QDateTime::currentDateTime().msecsTo(nextMidnight) + 1000;
+    midnightTimer->start(int(qBound<qint64>(1000, msecs, 24 * 60 * 60 * 1000)));
+}
+
+void DiaryWindow::onMidnight()
+{
+    if (isVisible()) {
+        // Don't move focus or scroll under the user; just add the day
+        editor->checkAndUpdateDate();
+    } else {
+        prepareForShow();
+    }
+    scheduleMidnight();
+}
+
+void DiaryWindow::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    prepareForShow();
+    trimTimer->start();
+}
+
+void DiaryWindow::paintEvent(QPaintEvent *event)
+{
+    if (activationTimer.isValid()) {
+        activationLatency = activationTimer.elapsed();
+        activationTimer.invalidate();
+    }
+    QWidget::paintEvent(event);
+}
+
 void DiaryWindow::positionWindow()
 {
     QPoint cursorPos = QCursor::pos();
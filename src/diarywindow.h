@@ -2,8 +2,13 @@
 
 #include <QWidget>
 #include <QSystemTrayIcon>
+#include <QLineEdit>
+#include <QElapsedTimer>
+#include <QTimer>
 #include "diaryeditor.h"
 
+class QMenu;
+
 class DiaryWindow : public QWidget
 {
     Q_OBJECT
@@ -11,18 +16,35 @@ class DiaryWindow : public QWidget
 public:
     DiaryWindow(QWidget *parent = nullptr);
     ~DiaryWindow();
+    QJsonObject stats() const;
 
 protected:
     void focusOutEvent(QFocusEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
 
 private Q_SLOTS:
     void trayIconActivated(QSystemTrayIcon::ActivationReason reason);
     void positionWindow();
+    void showJumpToDate();
+    void jumpToDate();
+    void showStats();
+    void populateTagMenu(QMenu *menu);
+    void prepareForShow();
+    void onMidnight();
 
 private:
     DiaryEditor *editor;
     QSystemTrayIcon *trayIcon;
+    QLineEdit *jumpEdit;
+    QAction *jumpEditAction;
+    QTimer *midnightTimer;
+    QTimer *trimTimer;
+    QDate preparedDate;
+    QElapsedTimer activationTimer;
+    qint64 activationLatency;
+    void scheduleMidnight();
     void createActions();
     void setupUI();
 };
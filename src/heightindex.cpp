@@ -0,0 +1,82 @@
+#include "heightindex.h"
+
+static inline int lowBit(int i)
+{
+    return i & -i;
+}
+
+void HeightIndex::clear()
+{
+    values.clear();
+    tree.clear();
+}
+
+void HeightIndex::reset(const QList<int> &heights)
+{
+    // Linear-time build: each node pushes its sum to its parent once
+    values = heights;
+    tree = heights;
+    const int n = tree.size();
+    for (int i = 1; i <= n; ++i) {
+        int parent = i + lowBit(i);
+        if (parent <= n)
+            tree[parent - 1] += tree[i - 1];
+    }
+}
+
+void HeightIndex::insert(int row, int height)
+{
+    if (row != values.size()) {
+        // Inserting in the middle shifts every later node; rebuild
+        QList<int> heights = values;
+        heights.insert(row, height);
+        reset(heights);
+        return;
+    }
+
+    // Appending only needs the sum of the range the new node covers
+    const int n = values.size() + 1;
+    int node = height + offsetOf(n - 1) - offsetOf(n - lowBit(n));
+    values.append(height);
+    tree.append(node);
+}
+
+void HeightIndex::set(int row, int height)
+{
+    int delta = height - values.at(row);
+    if (delta == 0)
+        return;
+    values[row] = height;
+    for (int i = row + 1; i <= tree.size(); i += lowBit(i))
+        tree[i - 1] += delta;
+}
+
+int HeightIndex::offsetOf(int row) const
+{
+    int sum = 0;
+    for (int i = row; i > 0; i -= lowBit(i))
+        sum += tree.at(i - 1);
+    return sum;
+}
+
+int HeightIndex::rowAt(int offset) const
+{
+    const int n = tree.size();
+    if (n == 0)
+        return -1;
+
+    // Descend the tree to find the last row starting at or before offset
+    int step = 1;
+    while (step * 2 <= n)
+        step *= 2;
+
+    int pos = 0;
+    int remaining = offset;
+    for (; step > 0; step /= 2) {
+        if (pos + step <= n && tree.at(pos + step - 1) <= remaining) {
+            pos += step;
+            remaining -= tree.at(pos - 1);
+        }
+    }
+    return qMin(pos, n - 1);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QList>
+
+// Prefix sums over per-row heights, stored as a Fenwick tree.
+// Changing one row's height and asking for the offset of any row are
+// both O(log n), so scroll targets never need a full layout pass.
+class HeightIndex
+{
+public:
+    int count() const { return values.size(); }
+    void clear();
+    void reset(const QList<int> &heights);
+    void insert(int row, int height);
+    void set(int row, int height);
+
+    int value(int row) const { return values.at(row); }
+    int offsetOf(int row) const;
+    int total() const { return offsetOf(values.size()); }
+    int rowAt(int offset) const;
+
+private:
+    QList<int> values;
+    QList<int> tree;
+};
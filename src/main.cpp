@@ -1,7 +1,14 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QFile>
+#include <QSaveFile>
 #include <KAboutData>
 #include <KLocalizedString>
 #include "diarywindow.h"
+#include "snapshotstore.h"
+#include "diaryimporter.h"
 
 int main(int argc, char *argv[])
 {
@@ -19,6 +26,85 @@ int main(int argc, char *argv[])
 
     KAboutData::setApplicationData(aboutData);
 
+    QCommandLineParser parser;
+    aboutData.setupCommandLine(&parser);
+    QCommandLineOption dumpStatsOption(QStringLiteral("dump-stats"),
+                                       i18n("Load the diary, print memory statistics as JSON and exit."));
+    parser.addOption(dumpStatsOption);
+    QCommandLineOption listSnapshotsOption(QStringLiteral("list-snapshots"),
+                                           i18n("List the saved history snapshots and exit."));
+    parser.addOption(listSnapshotsOption);
+    QCommandLineOption restoreSnapshotOption(QStringLiteral("restore-snapshot"),
+                                             i18n("Replace the diary with the given history snapshot and exit."),
+                                             i18n("id"));
+    parser.addOption(restoreSnapshotOption);
+    QCommandLineOption importOption(QStringLiteral("import"),
+                                    i18n("Merge a folder of daily note files into the diary and exit."),
+                                    i18n("directory"));
+    parser.addOption(importOption);
+    parser.process(app);
+    aboutData.processCommandLine(&parser);
+
+    if (parser.isSet(dumpStatsOption)) {
+        DiaryEditor editor;
+        QTextStream(stdout) << QString::fromUtf8(QJsonDocument(editor.stats()).toJson(QJsonDocument::Indented));
+        return 0;
+    }
+
+    if (parser.isSet(listSnapshotsOption)) {
+        SnapshotStore store(DiaryEditor::snapshotDirectory(DiaryEditor::defaultContentFile()));
+        QTextStream out(stdout);
+        const QStringList ids = store.snapshots();
+        for (const QString &id : ids)
+            out << id << '\n';
+        return 0;
+    }
+
+    if (parser.isSet(restoreSnapshotOption)) {
+        const QString contentFile = DiaryEditor::defaultContentFile();
+        SnapshotStore store(DiaryEditor::snapshotDirectory(contentFile));
+
+        DiaryModel restored;
+        if (!store.restore(parser.value(restoreSnapshotOption), restored)) {
+            QTextStream(stderr) << i18n("Could not restore snapshot %1", parser.value(restoreSnapshotOption)) << '\n';
+            return 1;
+        }
+
+        // Snapshot the current diary first so the restore can itself be undone
+        QFile file(contentFile);
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            DiaryModel current;
+            current.parse(QString::fromUtf8(file.readAll()));
+            store.snapshot(current);
+        }
+
+        QSaveFile out(contentFile);
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            return 1;
+        }
+        out.write(restored.serialize().toUtf8());
+        return out.commit() ? 0 : 1;
+    }
+
+    if (parser.isSet(importOption)) {
+        const QString contentFile = DiaryEditor::defaultContentFile();
+        DiaryImporter importer(parser.value(importOption));
+        if (!importer.importInto(contentFile, DiaryEditor::snapshotDirectory(contentFile))) {
+            QTextStream(stderr) << i18n("Import failed: %1", importer.errorString()) << '\n';
+            return 1;
+        }
+
+        const double seconds = qMax<qint64>(1, importer.elapsedMs()) / 1000.0;
+        QTextStream(stdout) << i18n("Imported %1 files (%2 skipped) with %3 days, %4 merged into existing days",
+                                    importer.fileCount(), importer.skippedCount(),
+                                    importer.dayCount(), importer.mergedCount()) << '\n'
+                            << i18n("%1 ms, %2 files/s, %3 MB/s",
+                                    importer.elapsedMs(),
+                                    QString::number(importer.fileCount() / seconds, 'f', 0),
+                                    QString::number(importer.byteCount() / seconds / (1024 * 1024), 'f', 1)) << '\n';
+        return 0;
+    }
+
     DiaryWindow *window = new DiaryWindow();
     return app.exec();
 }
@@ -0,0 +1,185 @@
+#include "snapshotstore.h"
+#include "diarymodel.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <utility>
+
+// A snapshot stores its full day list once its parent chain gets this long,
+// bounding how many files a restore has to read
+static const int MaxSnapshotChain = 32;
+
+static const QByteArray SnapshotMagic("kdailynote-snapshot 1");
+
+SnapshotStore::SnapshotStore(const QString &directory)
+    : root(directory)
+    , latestDepth(0)
+    , latestLoaded(false)
+{
+}
+
+QString SnapshotStore::objectPath(const QByteArray &hash) const
+{
+    const QString hex = QString::fromLatin1(hash.toHex());
+    return root + QStringLiteral("/objects/") + hex.left(2) + QLatin1Char('/') + hex.mid(2);
+}
+
+QString SnapshotStore::snapshotPath(const QString &id) const
+{
+    return root + QStringLiteral("/snapshots/") + id + QStringLiteral(".snap");
+}
+
+QStringList SnapshotStore::snapshots() const
+{
+    QDir dir(root + QStringLiteral("/snapshots"));
+    QStringList ids;
+    const QStringList files = dir.entryList({QStringLiteral("*.snap")}, QDir::Files, QDir::Name);
+    for (const QString &file : files)
+        ids.append(file.chopped(5));
+    return ids;
+}
+
+bool SnapshotStore::writeObject(const QByteArray &hash, const QByteArray &markdown) const
+{
+    const QString path = objectPath(hash);
+    if (QFile::exists(path))
+        return true;
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(markdown);
+    return file.commit();
+}
+
+bool SnapshotStore::readEntries(const QString &id, Entries &entries, int *depth) const
+{
+    // Collect the chain back to a full snapshot, then replay it oldest first
+    QList<QList<QByteArray>> chain;
+    QString current = id;
+    while (!current.isEmpty()) {
+        if (chain.size() > MaxSnapshotChain)
+            return false;
+
+        QFile file(snapshotPath(current));
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+        QList<QByteArray> lines = file.readAll().split('\n');
+        if (lines.isEmpty() || lines.first() != SnapshotMagic)
+            return false;
+        lines.removeFirst();
+
+        current.clear();
+        if (!lines.isEmpty() && lines.first().startsWith("parent ")) {
+            current = QString::fromLatin1(lines.first().mid(7));
+            lines.removeFirst();
+        }
+        chain.prepend(lines);
+    }
+
+    entries.clear();
+    for (const QList<QByteArray> &lines : std::as_const(chain)) {
+        for (const QByteArray &line : lines) {
+            const QList<QByteArray> fields = line.split(' ');
+            if (fields.size() != 2)
+                continue;
+            QDate date = QDate::fromString(QString::fromLatin1(fields.at(0)), Qt::ISODate);
+            if (!date.isValid())
+                continue;
+            if (fields.at(1) == "-")
+                entries.remove(date);
+            else
+                entries.insert(date, QByteArray::fromHex(fields.at(1)));
+        }
+    }
+    if (depth)
+        *depth = chain.size() - 1;
+    return true;
+}
+
+void SnapshotStore::loadLatest()
+{
+    if (latestLoaded)
+        return;
+    latestLoaded = true;
+
+    const QStringList ids = snapshots();
+    if (ids.isEmpty() || !readEntries(ids.last(), latestEntries, &latestDepth)) {
+        latestEntries.clear();
+        return;
+    }
+    latestId = ids.last();
+}
+
+QString SnapshotStore::snapshot(const DiaryModel &model)
+{
+    loadLatest();
+
+    Entries entries;
+    for (int row = 0; row < model.count(); ++row) {
+        const DayRecord &record = model.day(row);
+        if (record.markdown.isEmpty())
+            continue;
+        const QByteArray hash = model.contentHash(row);
+        if (latestEntries.value(record.date) != hash && !writeObject(hash, record.markdown))
+            return QString();
+        entries.insert(record.date, hash);
+    }
+    if (!latestId.isEmpty() && entries == latestEntries)
+        return QString();
+
+    // Record only what differs from the parent, unless the chain is too long
+    const bool full = latestId.isEmpty() || latestDepth + 1 >= MaxSnapshotChain;
+    QByteArray data = SnapshotMagic + '\n';
+    if (!full)
+        data += "parent " + latestId.toLatin1() + '\n';
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        if (full || latestEntries.value(it.key()) != it.value())
+            data += it.key().toString(Qt::ISODate).toLatin1() + ' ' + it.value().toHex() + '\n';
+    }
+    if (!full) {
+        for (auto it = latestEntries.cbegin(); it != latestEntries.cend(); ++it) {
+            if (!entries.contains(it.key()))
+                data += it.key().toString(Qt::ISODate).toLatin1() + " -\n";
+        }
+    }
+
+    QString id = QDateTime::currentDateTimeUtc().toString(QStringLiteral("yyyyMMdd-HHmmss-zzz"));
+    if (!latestId.isEmpty() && id <= latestId)
+        id = latestId + QStringLiteral("-1");
+
+    QDir().mkpath(root + QStringLiteral("/snapshots"));
+    QSaveFile file(snapshotPath(id));
+    if (!file.open(QIODevice::WriteOnly))
+        return QString();
+    file.write(data);
+    if (!file.commit())
+        return QString();
+
+    latestId = id;
+    latestEntries = entries;
+    latestDepth = full ? 0 : latestDepth + 1;
+    return id;
+}
+
+bool SnapshotStore::restore(const QString &id, DiaryModel &model) const
+{
+    Entries entries;
+    if (!readEntries(id, entries))
+        return false;
+
+    model.clear();
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        QFile object(objectPath(it.value()));
+        if (!object.open(QIODevice::ReadOnly))
+            return false;
+        const QByteArray markdown = object.readAll();
+        if (DiaryModel::hashMarkdown(markdown) != it.value())
+            return false;
+        model.insertDay(it.key(), markdown);
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDate>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+class DiaryModel;
+
+// Content-addressed history of the diary.
+// Each day body is stored once under its hash in objects/, and a
+// snapshot only records the days whose hash differs from its parent's,
+// so storage grows with the days that changed rather than diary size.
+class SnapshotStore
+{
+public:
+    explicit SnapshotStore(const QString &directory);
+
+    QString snapshot(const DiaryModel &model);
+    QStringList snapshots() const;
+    bool restore(const QString &id, DiaryModel &model) const;
+
+private:
+    using Entries = QMap<QDate, QByteArray>;    // Date to content hash
+
+    QString root;
+    QString latestId;
+    Entries latestEntries;
+    int latestDepth;
+    bool latestLoaded;
+
+    QString objectPath(const QByteArray &hash) const;
+    QString snapshotPath(const QString &id) const;
+    bool writeObject(const QByteArray &hash, const QByteArray &markdown) const;
+    bool readEntries(const QString &id, Entries &entries, int *depth = nullptr) const;
+    void loadLatest();
+};
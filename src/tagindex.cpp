@@ -0,0 +1,80 @@
+#include "tagindex.h"
+
+TagIndex::TagIndex(QObject *parent)
+    : QObject(parent)
+{
+}
+
+static bool isTagChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == QLatin1Char('_') || c == QLatin1Char('-');
+}
+
+QStringList TagIndex::extract(QStringView text)
+{
+    QStringList tokens;
+    const int n = text.size();
+    for (int i = 0; i < n; ++i) {
+        const QChar c = text[i];
+        if (c != QLatin1Char('#') && c != QLatin1Char('@'))
+            continue;
+        // Skip e-mail addresses and words like C#
+        if (i > 0 && isTagChar(text[i - 1]))
+            continue;
+
+        int end = i + 1;
+        bool hasLetter = false;
+        while (end < n && isTagChar(text[end])) {
+            hasLetter = hasLetter || text[end].isLetter();
+            ++end;
+        }
+        while (end > i + 1 && text[end - 1] == QLatin1Char('-'))
+            --end;
+
+        // Plain numbers such as #3 are not tags
+        if (hasLetter)
+            tokens.append(text.mid(i, end - i).toString().toLower());
+        i = end - 1;
+    }
+    return tokens;
+}
+
+void TagIndex::setDayTags(const QDate &date, const TagCounts &counts)
+{
+    const TagCounts previous = days.value(date);
+    if (previous == counts)
+        return;
+
+    for (auto it = previous.cbegin(); it != previous.cend(); ++it) {
+        if (counts.contains(it.key()))
+            continue;
+        auto tag = index.find(it.key());
+        if (tag != index.end()) {
+            tag->remove(date);
+            if (tag->isEmpty())
+                index.erase(tag);
+        }
+    }
+    for (auto it = counts.cbegin(); it != counts.cend(); ++it)
+        index[it.key()].insert(date, it.value());
+
+    if (counts.isEmpty())
+        days.remove(date);
+    else
+        days.insert(date, counts);
+}
+
+void TagIndex::clear()
+{
+    days.clear();
+    index.clear();
+}
+
+int TagIndex::count(const QString &tag) const
+{
+    int total = 0;
+    const QMap<QDate, int> tagDates = index.value(tag);
+    for (int dayCount : tagDates)
+        total += dayCount;
+    return total;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QObject>
+#include <QDate>
+#include <QHash>
+#include <QMap>
+#include <QStringList>
+
+using TagCounts = QHash<QString, int>;
+
+// Index from #tags and @mentions to the days using them.
+// Days report their own counts as they change, so the index is only
+// ever updated for the one day that was edited.
+class TagIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TagIndex(QObject *parent = nullptr);
+
+    static QStringList extract(QStringView text);
+
+    void setDayTags(const QDate &date, const TagCounts &counts);
+    void clear();
+
+    QStringList tags() const { return index.keys(); }
+    QMap<QDate, int> dates(const QString &tag) const { return index.value(tag); }
+    int count(const QString &tag) const;
+
+private:
+    QHash<QDate, TagCounts> days;
+    QMap<QString, QMap<QDate, int>> index;
+};
@@ -1,26 +1,60 @@
 #include <QtTest>
 #include <QSignalSpy>
-#include <QTemporaryFile>
+#include <QTemporaryDir>
+#include <QStandardPaths>
 #include <QTextStream>
+#include <QJsonArray>
+#include <QMimeData>
 #include "../diaryeditor.h"
+#include "../diarywindow.h"
 #include "../dayeditor.h"
+#include "../daycache.h"
+
+// Exposes the paste entry point that the clipboard and drops go through
+class PasteTestEditor : public DayEditor
+{
+public:
+    using DayEditor::DayEditor;
+    using DayEditor::insertFromMimeData;
+};
 
 class TestDiaryEditor : public QObject
 {
     Q_OBJECT
 
 private Q_SLOTS:
+    void initTestCase();
     void testMarkdownConversion();
     void testRichTextConversion();
+    void testMarkdownRoundTrip();
+    void testUndoAfterSync();
+    void testDayTopMatchesLayout();
+    void testNewDayBeforeFutureDay();
+    void testStats();
+    void testPasteSanitizing();
+    void testChunkedPaste();
+    void testGiantDayCollapses();
+    void testIncrementalTags();
+    void testParseCache();
+    void testTrimMemory();
+    void testActivationLatency();
 };
 
+void TestDiaryEditor::initTestCase()
+{
+    // Keep the default diary, its cache and snapshots away from real user data
+    QStandardPaths::setTestModeEnabled(true);
+}
+
 void TestDiaryEditor::testMarkdownConversion()
 {
     DiaryEditor editor;
     
-    // Create a temporary file with markdown content
-    QTemporaryFile tempFile;
-    tempFile.open();
+    // Create a temporary file with markdown content, in its own directory
+    // so the cache and snapshots written next to it are cleaned up too
+    QTemporaryDir tempDir;
+    QFile tempFile(tempDir.filePath(QStringLiteral("diary.md")));
+    tempFile.open(QIODevice::WriteOnly);
     tempFile.write(QStringLiteral("# 2024-01-01\nThis is **bold** and *italic* and _underlined_ text").toUtf8());
     tempFile.close();
     
@@ -52,18 +86,17 @@ void TestDiaryEditor::testRichTextConversion()
 {
     DiaryEditor editor;
     
-    // Create a temporary file for output
-    QTemporaryFile tempFile;
-    tempFile.open();
-    QString tempFileName = tempFile.fileName();
-    tempFile.close();
+    // Create a temporary file for output, in its own directory so the
+    // snapshots saved next to it are cleaned up too
+    QTemporaryDir tempDir;
+    QString tempFileName = tempDir.filePath(QStringLiteral("diary.md"));
+    QFile tempFile(tempFileName);
     
     editor.setContentFile(tempFileName);
     editor.setProperty("skipDateHeader", true);
     
     // Create a day editor for testing
     QDate testDate(2024, 1, 1);
-    editor.addDateHeader(testDate);
     DayEditor *dayEditor = editor.createDayEditor(testDate);
     QVERIFY2(dayEditor != nullptr, "Failed to create DayEditor");
     
@@ -100,7 +133,7 @@ void TestDiaryEditor::testRichTextConversion()
     // Save and verify content
     editor.saveContent();
     
-    tempFile.open();
+    tempFile.open(QIODevice::ReadOnly);
     QTextStream in(&tempFile);
     QString savedContent = in.readAll();
     tempFile.close();
@@ -128,7 +161,7 @@ void TestDiaryEditor::testRichTextConversion()
     
     editor.saveContent();
     
-    tempFile.open();
+    tempFile.open(QIODevice::ReadOnly);
     savedContent = QString::fromUtf8(tempFile.readAll());
     tempFile.close();
     
@@ -149,7 +182,7 @@ void TestDiaryEditor::testRichTextConversion()
     
     editor.saveContent();
     
-    tempFile.open();
+    tempFile.open(QIODevice::ReadOnly);
     savedContent = QString::fromUtf8(tempFile.readAll());
     tempFile.close();
     
@@ -158,5 +191,368 @@ void TestDiaryEditor::testRichTextConversion()
                        .arg(savedContent)));
 }
 
+void TestDiaryEditor::testMarkdownRoundTrip()
+{
+    DayEditor dayEditor(QDate(2024, 1, 1));
+    const QString markdown = QStringLiteral("***both*** and _under_ <b>literal</b>\n\nsecond paragraph");
+    dayEditor.setContent(markdown);
+    
+    QCOMPARE(dayEditor.document()->blockCount(), 2);
+    QCOMPARE(dayEditor.content(), markdown);
+    QVERIFY2(!dayEditor.document()->isModified(), "Loading content should not mark the document modified");
+    
+    // A lone star stays text even when a bold pair follows it
+    const QStringList loneStars = {
+        QStringLiteral("Rated it 4* - **great**"),
+        QStringLiteral("*foo **bar**"),
+    };
+    for (const QString &text : loneStars) {
+        const DayContent parsed = DayContent::fromMarkdown(text);
+        QCOMPARE(parsed.blocks.at(0).runs.size(), 2);
+        QCOMPARE(parsed.blocks.at(0).runs.at(0).format, quint8(DayContent::Plain));
+        QCOMPARE(parsed.blocks.at(0).runs.at(1).format, quint8(DayContent::Bold));
+        dayEditor.setContent(text);
+        QCOMPARE(dayEditor.content(), text);
+    }
+}
+
+void TestDiaryEditor::testUndoAfterSync()
+{
+    DiaryEditor editor;
+    editor.setProperty("skipDateHeader", true);
+    editor.parseContent(QStringLiteral("# 2024-01-01\nOriginal\n"));
+    DayEditor *dayEditor = editor.findChild<DayEditor*>();
+    QVERIFY(dayEditor);
+    
+    QTextCursor cursor(dayEditor->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(QStringLiteral(" edit"));
+    QCOMPARE(editor.serializeContent(), QStringLiteral("# 2024-01-01\n\nOriginal edit\n\n"));
+    
+    // Undoing back to the loaded text must reach the model as well
+    dayEditor->document()->undo();
+    QVERIFY(!dayEditor->document()->isModified());
+    QCOMPARE(editor.serializeContent(), QStringLiteral("# 2024-01-01\n\nOriginal\n\n"));
+}
+
+void TestDiaryEditor::testDayTopMatchesLayout()
+{
+    DiaryEditor editor;
+    editor.setProperty("skipDateHeader", true);
+    QString content;
+    for (int day = 1; day <= 20; ++day)
+        content += QStringLiteral("# 2024-01-%1\nDay %2\n\n").arg(day, 2, 10, QLatin1Char('0')).arg(day);
+    editor.parseContent(content);
+    editor.resize(400, 300);
+    editor.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&editor));
+    
+    // Every editor sits the same distance below its day's computed top
+    const QList<DayEditor*> dayEditors = editor.findChildren<DayEditor*>();
+    QCOMPARE(dayEditors.size(), 20);
+    DiaryModel *model = editor.diaryModel();
+    auto headerOffsetsMatch = [&]() {
+        const int headerOffset = dayEditors.at(0)->y() - editor.dayTop(model->indexOf(dayEditors.at(0)->date()));
+        for (DayEditor *dayEditor : dayEditors) {
+            if (dayEditor->y() - editor.dayTop(model->indexOf(dayEditor->date())) != headerOffset)
+                return false;
+        }
+        return headerOffset > 0;
+    };
+    // Editors re-measure once they know their width, so let layout settle
+    QTRY_VERIFY(headerOffsetsMatch());
+}
+
+void TestDiaryEditor::testNewDayBeforeFutureDay()
+{
+    const QDate today = QDate::currentDate();
+    DiaryEditor editor;
+    editor.parseContent(QStringLiteral("# %1\nLast year\n\n# %2\nPlanned ahead\n")
+                            .arg(today.addYears(-1).toString(Qt::ISODate), today.addYears(1).toString(Qt::ISODate)));
+    editor.checkAndUpdateDate();
+    
+    // Today's day lands between the two, in the layout as in the model
+    DiaryModel *model = editor.diaryModel();
+    QCOMPARE(model->count(), 3);
+    QCOMPARE(model->day(1).date, today);
+    QList<QDate> layoutDates;
+    QLayout *layout = editor.widget()->layout();
+    for (int i = 0; i < layout->count(); ++i) {
+        if (DayEditor *dayEditor = qobject_cast<DayEditor*>(layout->itemAt(i)->widget()))
+            layoutDates.append(dayEditor->date());
+    }
+    QCOMPARE(layoutDates, QList<QDate>({today.addYears(-1), today, today.addYears(1)}));
+    
+    // Each editor knows its row, and follows changes made to the model
+    for (DayEditor *dayEditor : editor.findChildren<DayEditor*>())
+        QCOMPARE(dayEditor->row(), model->indexOf(dayEditor->date()));
+    model->setMarkdown(2, QByteArrayLiteral("Moved to next month"));
+    for (DayEditor *dayEditor : editor.findChildren<DayEditor*>()) {
+        if (dayEditor->date() == today.addYears(1))
+            QCOMPARE(dayEditor->content(), QStringLiteral("Moved to next month"));
+    }
+    
+    editor.resize(400, 300);
+    editor.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&editor));
+    const QList<DayEditor*> dayEditors = editor.findChildren<DayEditor*>();
+    auto headerOffsetsMatch = [&]() {
+        const int headerOffset = dayEditors.at(0)->y() - editor.dayTop(model->indexOf(dayEditors.at(0)->date()));
+        for (DayEditor *dayEditor : dayEditors) {
+            if (dayEditor->y() - editor.dayTop(model->indexOf(dayEditor->date())) != headerOffset)
+                return false;
+        }
+        return headerOffset > 0;
+    };
+    QTRY_VERIFY(headerOffsetsMatch());
+}
+
+void TestDiaryEditor::testStats()
+{
+    DiaryEditor editor;
+    editor.setProperty("skipDateHeader", true);
+    editor.parseContent(QStringLiteral("# 2024-01-01\nOne **two**\n\nthree\n# 2024-01-02\nfour\n"));
+    
+    const QJsonObject stats = editor.stats();
+    const QJsonObject total = stats.value(QStringLiteral("total")).toObject();
+    QCOMPARE(total.value(QStringLiteral("days")).toInt(), 2);
+    QCOMPARE(total.value(QStringLiteral("editors")).toInt(), 2);
+    QCOMPARE(total.value(QStringLiteral("blocks")).toInt(), 3);
+    QCOMPARE(stats.value(QStringLiteral("days")).toArray().size(), 2);
+    
+    const QJsonObject firstDay = stats.value(QStringLiteral("days")).toArray().at(0).toObject();
+    QCOMPARE(firstDay.value(QStringLiteral("date")).toString(), QStringLiteral("2024-01-01"));
+    QCOMPARE(firstDay.value(QStringLiteral("fragments")).toInt(), 3);
+}
+
+void TestDiaryEditor::testPasteSanitizing()
+{
+    const QString html = QStringLiteral(
+        "<html><head><title>Page</title><style>p { color: red; }</style></head><body>"
+        "<p>Hello   <b>bold</b> &amp; <span style=\" font-style:italic;\">it</span></p>"
+        "<script>alert(1);</script><div><font color=\"red\">Second</font></div></body></html>");
+    
+    DayContent pasted = DayContent::fromHtml(html);
+    QCOMPARE(pasted.blocks.size(), 2);
+    QCOMPARE(pasted.blocks.at(0).text, QStringLiteral("Hello bold & it"));
+    QCOMPARE(pasted.blocks.at(1).text, QStringLiteral("Second"));
+    
+    DayEditor dayEditor(QDate(2024, 1, 1));
+    dayEditor.setDayContent(pasted);
+    QCOMPARE(dayEditor.content(), QStringLiteral("Hello **bold** & *it*\n\nSecond"));
+    
+    // Entities outside the BMP survive as surrogate pairs
+    const QString grin = QString::fromUtf8("\xF0\x9F\x98\x80");
+    QCOMPARE(DayContent::fromHtml(u"&#x1F600; &#128512;").blocks.at(0).text, grin + QLatin1Char(' ') + grin);
+    
+    // Preformatted text keeps its lines, spacing and blank lines
+    DayContent log = DayContent::fromHtml(
+        u"<p>Log:</p><pre>\nfirst  line\n\n\tthird</pre><div style=\"white-space: pre\">a\nb</div>tail");
+    QCOMPARE(log.blocks.size(), 7);
+    QCOMPARE(log.blocks.at(1).text, QStringLiteral("first  line"));
+    QCOMPARE(log.blocks.at(2).text, QString());
+    QCOMPARE(log.blocks.at(3).text, QStringLiteral("\tthird"));
+    QCOMPARE(log.blocks.at(5).text, QStringLiteral("b"));
+    QCOMPARE(log.blocks.at(6).text, QStringLiteral("tail"));
+    
+    // A slice of a block keeps the formats of the runs it crosses
+    QTextDocument slice;
+    QTextCursor sliceCursor(&slice);
+    DayContent::insertBlock(sliceCursor, DayContent::fromMarkdown(QStringLiteral("ab**cd**ef")).blocks.at(0), 1, 2);
+    QCOMPARE(slice.toPlainText(), QStringLiteral("bc"));
+    
+    DayContent lines = DayContent::fromPlainText(u"one\r\ntwo\nthree");
+    QCOMPARE(lines.blocks.size(), 3);
+    QCOMPARE(lines.blocks.at(1).text, QStringLiteral("two"));
+}
+
+void TestDiaryEditor::testChunkedPaste()
+{
+    PasteTestEditor dayEditor(QDate(2024, 1, 1));
+    dayEditor.setContent(QStringLiteral("Before"));
+    dayEditor.moveCursor(QTextCursor::End);
+    
+    QStringList lines;
+    for (int i = 0; i < 5000; ++i)
+        lines.append(QStringLiteral("line %1 of a long log").arg(i));
+    const QString pasted = lines.join(QLatin1Char('\n'));
+    QMimeData mime;
+    mime.setText(pasted);
+    
+    // Only the first chunk goes in right away; the rest follows from the event loop
+    dayEditor.insertFromMimeData(&mime);
+    QVERIFY(dayEditor.toPlainText().size() < 6 + pasted.size());
+    QTRY_COMPARE(dayEditor.toPlainText(), QStringLiteral("Before") + pasted);
+    
+    // The whole paste undoes as one step
+    dayEditor.document()->undo();
+    QCOMPARE(dayEditor.toPlainText(), QStringLiteral("Before"));
+    
+    // A key press finishes the pending chunks before it is handled
+    dayEditor.moveCursor(QTextCursor::End);
+    dayEditor.insertFromMimeData(&mime);
+    QTest::keyClick(&dayEditor, Qt::Key_X);
+    QCOMPARE(dayEditor.toPlainText(), QStringLiteral("Before") + pasted + QLatin1Char('x'));
+}
+
+void TestDiaryEditor::testGiantDayCollapses()
+{
+    DayEditor dayEditor(QDate(2024, 1, 1));
+    dayEditor.setCollapsedHeight(300);
+    
+    dayEditor.setContent(QStringLiteral("short"));
+    QVERIFY(dayEditor.maximumHeight() < 300);
+    
+    // An ordinary long day keeps its full height instead of scrolling inside
+    QStringList lines;
+    for (int i = 0; i < 200; ++i)
+        lines.append(QStringLiteral("line %1").arg(i));
+    dayEditor.setContent(lines.join(QStringLiteral("\n\n")));
+    QVERIFY(dayEditor.maximumHeight() > 300);
+    
+    // A giant day is collapsed without being measured
+    dayEditor.setContent(QString(60000, QLatin1Char('x')));
+    QCOMPARE(dayEditor.minimumHeight(), 300);
+    QCOMPARE(dayEditor.maximumHeight(), 300);
+}
+
+void TestDiaryEditor::testIncrementalTags()
+{
+    DiaryEditor editor;
+    editor.setProperty("skipDateHeader", true);
+    editor.parseContent(QStringLiteral("# 2024-01-01\nMet @alice about **#work**\n\n#work again\n"));
+    
+    TagIndex *index = editor.tagIndex();
+    QCOMPARE(index->count(QStringLiteral("#work")), 2);
+    QCOMPARE(index->count(QStringLiteral("@alice")), 1);
+    
+    DayEditor *dayEditor = editor.findChild<DayEditor*>();
+    QVERIFY(dayEditor);
+    
+    // Deleting a whole paragraph drops its tags
+    QTextCursor cursor(dayEditor->document()->lastBlock());
+    cursor.movePosition(QTextCursor::PreviousCharacter);
+    cursor.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+    QCOMPARE(index->count(QStringLiteral("#work")), 1);
+    
+    // Typing a new tag adds it
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(QStringLiteral(" with @bob"));
+    QCOMPARE(index->count(QStringLiteral("@bob")), 1);
+    QCOMPARE(index->dates(QStringLiteral("@bob")).keys(), QList<QDate>({QDate(2024, 1, 1)}));
+}
+
+void TestDiaryEditor::testParseCache()
+{
+    DayContent content = DayContent::fromMarkdown(QStringLiteral("Plain **bold** #tag\n\n_second_"));
+    const QByteArray data = DayCache::serialize(content);
+    
+    DayContent restored;
+    QVERIFY(DayCache::deserialize(data, restored));
+    QCOMPARE(restored.blocks.size(), 2);
+    QCOMPARE(restored.blocks.at(0).text, content.blocks.at(0).text);
+    QCOMPARE(restored.blocks.at(0).runs.size(), content.blocks.at(0).runs.size());
+    QCOMPARE(restored.blocks.at(0).tags, QStringList({QStringLiteral("#tag")}));
+    
+    // Truncated entries are rejected rather than half-applied
+    QVERIFY(!DayCache::deserialize(data.left(data.size() - 3), restored));
+    
+    QTemporaryDir dir;
+    const QString cachePath = dir.filePath(QStringLiteral("diary.cache"));
+    DayCache cache(cachePath);
+    QVERIFY(!cache.load());
+    const QByteArray hash = DiaryModel::hashMarkdown("Plain **bold** #tag\n\n_second_");
+    cache.insert(hash, data);
+    QVERIFY(cache.save());
+    
+    DayCache reloaded(cachePath);
+    QVERIFY(reloaded.load());
+    QVERIFY(reloaded.lookup(hash, restored));
+    QVERIFY(!reloaded.lookup(DiaryModel::hashMarkdown("other"), restored));
+    
+    // A file written by another format version is ignored
+    QFile file(cachePath);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    file.seek(4);
+    QDataStream(&file) << quint32(0xffff);
+    file.close();
+    QVERIFY(!reloaded.load());
+    QVERIFY(!reloaded.lookup(hash, restored));
+    
+    // Loading a diary through DiaryEditor fills the cache next to it
+    QFile diary(dir.filePath(QStringLiteral("diary.md")));
+    QVERIFY(diary.open(QIODevice::WriteOnly));
+    diary.write("# 2024-01-01\nCached **day**\n");
+    diary.close();
+    
+    DiaryEditor editor;
+    editor.setProperty("skipDateHeader", true);
+    editor.setContentFile(diary.fileName());
+    editor.loadContent();
+    
+    DayCache written(cachePath);
+    QVERIFY(written.load());
+    QVERIFY(written.lookup(DiaryModel::hashMarkdown("Cached **day**"), restored));
+    
+    // A second load is served from the cache and yields the same document
+    editor.loadContent();
+    DayEditor *dayEditor = editor.findChild<DayEditor*>();
+    QVERIFY(dayEditor);
+    QCOMPARE(dayEditor->content(), QStringLiteral("Cached **day**"));
+}
+
+void TestDiaryEditor::testTrimMemory()
+{
+    DiaryEditor editor;
+    editor.setProperty("skipDateHeader", true);
+    
+    QString content;
+    for (int day = 1; day <= 10; ++day)
+        content += QStringLiteral("# 2024-01-%1\nDay %2 with #tag\n\n").arg(day, 2, 10, QLatin1Char('0')).arg(day);
+    editor.parseContent(content);
+    DayEditor *firstEditor = editor.findChild<DayEditor*>();
+    QVERIFY(firstEditor);
+    firstEditor->textCursor().insertText(QStringLiteral("Edited "));
+    const QString before = editor.serializeContent();
+    
+    editor.trimMemory(3);
+    
+    const QJsonObject stats = editor.stats();
+    QCOMPARE(stats.value(QStringLiteral("total")).toObject().value(QStringLiteral("editors")).toInt(), 3);
+    QCOMPARE(stats.value(QStringLiteral("lastTrim")).toObject().value(QStringLiteral("daysReleased")).toInt(), 7);
+    QCOMPARE(editor.findChildren<DayEditor*>().size(), 3);
+    
+    // Released days are still saved and indexed from their compact form
+    QCOMPARE(editor.serializeContent(), before);
+    QCOMPARE(editor.tagIndex()->count(QStringLiteral("#tag")), 10);
+    
+    // Jumping to a released day brings it back
+    editor.jumpToDate(QDate(2024, 1, 1));
+    QCOMPARE(editor.findChildren<DayEditor*>().size(), 4);
+    bool found = false;
+    const QList<DayEditor*> dayEditors = editor.findChildren<DayEditor*>();
+    for (DayEditor *dayEditor : dayEditors) {
+        if (dayEditor->date() == QDate(2024, 1, 1)) {
+            QCOMPARE(dayEditor->content(), QStringLiteral("Edited Day 1 with #tag"));
+            found = true;
+        }
+    }
+    QVERIFY(found);
+    QCOMPARE(editor.tagIndex()->count(QStringLiteral("#tag")), 10);
+}
+
+void TestDiaryEditor::testActivationLatency()
+{
+    DiaryWindow window;
+    QVERIFY(!window.stats().contains(QStringLiteral("activationLatencyMs")));
+    
+    // A tray click is timed until the window's first paint
+    QMetaObject::invokeMethod(&window, "trayIconActivated",
+                              Q_ARG(QSystemTrayIcon::ActivationReason, QSystemTrayIcon::Trigger));
+    QTRY_VERIFY(window.stats().contains(QStringLiteral("activationLatencyMs")));
+    QVERIFY(window.stats().value(QStringLiteral("activationLatencyMs")).toInteger() >= 0);
+}
+
 QTEST_MAIN(TestDiaryEditor)
 #include "testdiaryeditor.moc"
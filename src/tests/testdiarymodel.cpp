@@ -0,0 +1,239 @@
+#include <QtTest>
+#include <QSignalSpy>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include "../diarymodel.h"
+#include "../snapshotstore.h"
+#include "../tagindex.h"
+#include "../diaryimporter.h"
+
+class TestDiaryModel : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testSortedInsert();
+    void testParseAndSerialize();
+    void testDuplicateSectionsMerge();
+    void testHeightOffsets();
+    void testSnapshotDeduplication();
+    void testTagIndex();
+    void testImport();
+    void testImportMergesPartialMatches();
+};
+
+void TestDiaryModel::testSortedInsert()
+{
+    DiaryModel model;
+    QSignalSpy insertedSpy(&model, &DiaryModel::dayInserted);
+    
+    model.insertDay(QDate(2024, 1, 3));
+    model.insertDay(QDate(2024, 1, 1));
+    model.insertDay(QDate(2024, 1, 2));
+    
+    QCOMPARE(model.count(), 3);
+    QCOMPARE(insertedSpy.count(), 3);
+    QCOMPARE(model.day(0).date, QDate(2024, 1, 1));
+    QCOMPARE(model.day(1).date, QDate(2024, 1, 2));
+    QCOMPARE(model.day(2).date, QDate(2024, 1, 3));
+    
+    QCOMPARE(model.indexOf(QDate(2024, 1, 2)), 1);
+    QCOMPARE(model.indexOf(QDate(2024, 2, 1)), -1);
+    QCOMPARE(model.lowerBound(QDate(2023, 12, 31)), 0);
+    QCOMPARE(model.lowerBound(QDate(2024, 2, 1)), 3);
+}
+
+void TestDiaryModel::testParseAndSerialize()
+{
+    DiaryModel model;
+    model.parse(QStringLiteral("# 2024-01-02\n\nSecond **day**\n\n# 2024-01-01\n\nFirst day\n\n"));
+    
+    QCOMPARE(model.count(), 2);
+    QCOMPARE(model.day(0).date, QDate(2024, 1, 1));
+    QCOMPARE(model.day(0).markdown, QByteArray("First day"));
+    QCOMPARE(model.day(1).markdown, QByteArray("Second **day**"));
+    
+    QCOMPARE(model.serialize(),
+             QStringLiteral("# 2024-01-01\n\nFirst day\n\n# 2024-01-02\n\nSecond **day**\n\n"));
+    
+    // A day that was created but never written in is left out
+    model.insertDay(QDate(2024, 1, 3));
+    QCOMPARE(model.serialize(),
+             QStringLiteral("# 2024-01-01\n\nFirst day\n\n# 2024-01-02\n\nSecond **day**\n\n"));
+}
+
+void TestDiaryModel::testDuplicateSectionsMerge()
+{
+    DiaryModel model;
+    model.parse(QStringLiteral("# 2024-01-01\nMorning\n# 2024-01-01\nEvening\n"));
+    
+    QCOMPARE(model.count(), 1);
+    QCOMPARE(model.day(0).markdown, QByteArray("Morning\n\nEvening"));
+}
+
+void TestDiaryModel::testHeightOffsets()
+{
+    DiaryModel model;
+    for (int day = 1; day <= 10; ++day)
+        model.insertDay(QDate(2024, 1, day));
+    for (int row = 0; row < model.count(); ++row)
+        model.setHeight(row, 100);
+    
+    QCOMPARE(model.totalHeight(), 1000);
+    QCOMPARE(model.offsetOf(0), 0);
+    QCOMPARE(model.offsetOf(7), 700);
+    
+    // A single height change shifts every later offset
+    model.setHeight(2, 250);
+    QCOMPARE(model.offsetOf(2), 200);
+    QCOMPARE(model.offsetOf(3), 450);
+    QCOMPARE(model.totalHeight(), 1150);
+    
+    QCOMPARE(model.rowAt(0), 0);
+    QCOMPARE(model.rowAt(449), 2);
+    QCOMPARE(model.rowAt(450), 3);
+    QCOMPARE(model.rowAt(100000), 9);
+    
+    // Inserting before existing days keeps the offsets consistent
+    int row = model.insertDay(QDate(2023, 12, 31));
+    QCOMPARE(row, 0);
+    model.setHeight(row, 50);
+    QCOMPARE(model.offsetOf(1), 50);
+    QCOMPARE(model.offsetOf(4), 500);
+    QCOMPARE(model.totalHeight(), 1200);
+}
+
+static int countFiles(const QString &path)
+{
+    int count = 0;
+    QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        ++count;
+    }
+    return count;
+}
+
+void TestDiaryModel::testSnapshotDeduplication()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    
+    DiaryModel model;
+    model.parse(QStringLiteral("# 2024-01-01\nFirst\n# 2024-01-02\nSecond\n# 2024-01-03\nThird\n"));
+    const QString original = model.serialize();
+    
+    SnapshotStore store(dir.path());
+    const QString first = store.snapshot(model);
+    QVERIFY(!first.isEmpty());
+    QCOMPARE(countFiles(dir.path() + QStringLiteral("/objects")), 3);
+    
+    // Nothing changed, so nothing is stored
+    QVERIFY(store.snapshot(model).isEmpty());
+    
+    // Only the edited day adds an object
+    model.setMarkdown(1, QByteArray("Second, edited"));
+    model.insertDay(QDate(2024, 1, 4), QByteArray("Fourth"));
+    const QString second = store.snapshot(model);
+    QVERIFY(!second.isEmpty());
+    QCOMPARE(countFiles(dir.path() + QStringLiteral("/objects")), 5);
+    QCOMPARE(store.snapshots(), QStringList({first, second}));
+    
+    DiaryModel restored;
+    QVERIFY(store.restore(first, restored));
+    QCOMPARE(restored.serialize(), original);
+    
+    // A fresh store picks up the existing history
+    SnapshotStore reopened(dir.path());
+    QVERIFY(reopened.restore(second, restored));
+    QCOMPARE(restored.serialize(), model.serialize());
+}
+
+void TestDiaryModel::testTagIndex()
+{
+    QCOMPARE(TagIndex::extract(u"Lunch with @Alice, #work-life- and mail me@example.com about C# #42"),
+             QStringList({QStringLiteral("@alice"), QStringLiteral("#work-life")}));
+    
+    TagIndex index;
+    index.setDayTags(QDate(2024, 1, 1), {{QStringLiteral("#work"), 2}, {QStringLiteral("@alice"), 1}});
+    index.setDayTags(QDate(2024, 1, 2), {{QStringLiteral("#work"), 1}});
+    QCOMPARE(index.tags(), QStringList({QStringLiteral("#work"), QStringLiteral("@alice")}));
+    QCOMPARE(index.count(QStringLiteral("#work")), 3);
+    QCOMPARE(index.dates(QStringLiteral("#work")).keys(), QList<QDate>({QDate(2024, 1, 1), QDate(2024, 1, 2)}));
+    
+    // Updating one day only touches that day's entries
+    index.setDayTags(QDate(2024, 1, 1), {{QStringLiteral("#work"), 1}});
+    QCOMPARE(index.tags(), QStringList({QStringLiteral("#work")}));
+    QCOMPARE(index.count(QStringLiteral("#work")), 2);
+}
+
+static void writeFile(const QString &path, const QByteArray &data)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(data);
+}
+
+void TestDiaryModel::testImport()
+{
+    QTemporaryDir notes;
+    QTemporaryDir data;
+    QVERIFY(notes.isValid() && data.isValid());
+    
+    writeFile(notes.filePath(QStringLiteral("2024-01-05.md")),
+              "---\ntags: [daily]\n---\n# 2024-01-05\nImported note\r\n# Heading\nMore\n");
+    writeFile(notes.filePath(QStringLiteral("2024/01/06.txt")), "Folder dated note\n");
+    writeFile(notes.filePath(QStringLiteral("journal.txt")),
+              "[2024-01-07 09:30] Morning\nCoffee\n\n[2024-01-07 18:00] Evening\nDinner\n");
+    writeFile(notes.filePath(QStringLiteral("readme.md")), "No date here\n");
+    
+    const QString diary = data.filePath(QStringLiteral("diary.md"));
+    writeFile(diary, "# 2024-01-05\n\nAlready here\n\n");
+    
+    DiaryImporter importer(notes.path());
+    QVERIFY2(importer.importInto(diary), qPrintable(importer.errorString()));
+    QCOMPARE(importer.fileCount(), 4);
+    QCOMPARE(importer.skippedCount(), 1);
+    QCOMPARE(importer.dayCount(), 4);
+    QCOMPARE(importer.mergedCount(), 2);
+    
+    QFile file(diary);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    DiaryModel model;
+    model.parse(QString::fromUtf8(file.readAll()));
+    QCOMPARE(model.count(), 3);
+    QCOMPARE(model.day(0).markdown, QByteArray("Already here\n\nImported note\n\n**Heading**\n\nMore"));
+    QCOMPARE(model.day(1).markdown, QByteArray("Folder dated note"));
+    QCOMPARE(model.day(2).markdown, QByteArray("Morning\n\nCoffee\n\nEvening\n\nDinner"));
+    
+    // Importing the same notes again changes nothing
+    const QString before = model.serialize();
+    DiaryImporter again(notes.path());
+    QVERIFY(again.importInto(diary));
+    QCOMPARE(again.mergedCount(), 0);
+    file.close();
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    model.parse(QString::fromUtf8(file.readAll()));
+    QCOMPARE(model.serialize(), before);
+}
+
+void TestDiaryModel::testImportMergesPartialMatches()
+{
+    DiaryModel model;
+    model.insertDay(QDate(2024, 1, 1), "Yesterday was long\n\nNo");
+    
+    // Text that only occurs inside another note is still a new note
+    QList<ImportedDay> imported;
+    imported.append(ImportedDay{QDate(2024, 1, 1), "Yes"});
+    imported.append(ImportedDay{QDate(2024, 1, 1), "No"});
+    QCOMPARE(DiaryImporter::merge(model, imported), 1);
+    QCOMPARE(model.day(0).markdown, QByteArray("Yesterday was long\n\nNo\n\nYes"));
+    
+    // Merging again finds both as whole paragraphs
+    QCOMPARE(DiaryImporter::merge(model, imported), 0);
+}
+
+QTEST_GUILESS_MAIN(TestDiaryModel)
+#include "testdiarymodel.moc"